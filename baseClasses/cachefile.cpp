@@ -0,0 +1,259 @@
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cachefile.h"
+
+const char MAGIC[4] = { 'V', 'R', 'P', 'C' };
+const uint32_t FORMAT = 2;
+const size_t ALIGN = 64;
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t Cachefile::hash(uint64_t h, const void *data, size_t bytes) {
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i=0; i<bytes; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+
+uint64_t Cachefile::hash(const void *data, size_t bytes) {
+    return hash(FNV_OFFSET, data, bytes);
+}
+
+
+uint64_t Cachefile::hash(const std::string &file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::string errmsg = "Cachefile::hash - can not open '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        std::string errmsg = "Cachefile::hash - can not read '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    uint64_t h = FNV_OFFSET;
+    if (st.st_size > 0) {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            ::close(fd);
+            std::string errmsg = "Cachefile::hash - can not map '" + file + "'.";
+            throw std::runtime_error(errmsg);
+        }
+        madvise(m, st.st_size, MADV_SEQUENTIAL);
+        h = hash(h, m, st.st_size);
+        munmap(m, st.st_size);
+    }
+    ::close(fd);
+    return h;
+}
+
+
+bool Cachefile::open(const std::string &file, uint32_t kind, uint32_t version,
+                     uint64_t key) {
+    close();
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 or st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) return false;
+
+    const Header *h = (const Header *) m;
+    size_t size = st.st_size;
+    bool ok = !memcmp(h->magic, MAGIC, sizeof(MAGIC))
+              and h->format == FORMAT
+              and h->kind == kind
+              and h->version == version
+              and h->key == key
+              and h->table <= size
+              and h->table >= sizeof(Header)
+              and h->nsections <= (size - h->table) / sizeof(Section);
+
+    const Section *t = ok ? (const Section *) ((const char *) m + h->table) : NULL;
+    for (int i=0; ok and i<h->nsections; i++)
+        ok = t[i].offset <= size and t[i].bytes <= size - t[i].offset;
+
+    ok = ok and h->check == hash((const char *) m + sizeof(Header),
+                                 size - sizeof(Header));
+
+    if (!ok) {
+        munmap(m, st.st_size);
+        return false;
+    }
+
+    map = m;
+    mapbytes = st.st_size;
+    table = t;
+    nsections = h->nsections;
+    return true;
+}
+
+
+void Cachefile::close() {
+    if (map)
+        munmap(map, mapbytes);
+    map = NULL;
+    mapbytes = 0;
+    table = NULL;
+    nsections = 0;
+}
+
+
+const void* Cachefile::section(uint32_t id, size_t *bytes) const {
+    for (int i=0; i<nsections; i++) {
+        if (table[i].id != id) continue;
+        if (bytes) *bytes = table[i].bytes;
+        return (const char *) map + table[i].offset;
+    }
+    return NULL;
+}
+
+
+Cachewriter::Cachewriter(const std::string &_file, uint32_t kind,
+                         uint32_t version, uint64_t key) {
+    file = _file;
+
+    // a name no other writer of file can have, in its directory so the
+    // rename stays on one file system
+    std::vector<char> name(file.begin(), file.end());
+    const char suffix[] = ".XXXXXX";
+    name.insert(name.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(&name[0]);
+    if (fd == -1) {
+        std::string errmsg = "Cachewriter - can not create a temporary file for '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+    fchmod(fd, 0644);
+    ::close(fd);
+    tmpfile = &name[0];
+
+    out.open(tmpfile.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        remove(tmpfile.c_str());
+        std::string errmsg = "Cachewriter - can not create '" + tmpfile + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = FORMAT;
+    header.kind = kind;
+    header.version = version;
+    header.key = key;
+
+    // filled in by commit()
+    out.write((const char *) &header, sizeof(header));
+}
+
+
+// a writer that is not committed leaves no file behind
+Cachewriter::~Cachewriter() {
+    if (out.is_open()) {
+        out.close();
+        remove(tmpfile.c_str());
+    }
+}
+
+
+void Cachewriter::align() {
+    static const char zeros[ALIGN] = { 0 };
+    size_t pos = out.tellp();
+    if (pos % ALIGN)
+        out.write(zeros, ALIGN - pos % ALIGN);
+}
+
+
+void Cachewriter::check() {
+    if (!out) {
+        std::string errmsg = "Cachewriter - error writing '" + tmpfile + "'.";
+        throw std::runtime_error(errmsg);
+    }
+}
+
+
+std::ostream& Cachewriter::begin(uint32_t id) {
+    size_t pos = out.tellp();
+    if (table.size())
+        table.back().bytes = pos - table.back().offset;
+
+    align();
+    check();
+
+    Cachefile::Section s;
+    memset(&s, 0, sizeof(s));
+    s.id = id;
+    s.offset = out.tellp();
+    table.push_back(s);
+    return out;
+}
+
+
+void Cachewriter::commit() {
+    size_t pos = out.tellp();
+    if (table.size())
+        table.back().bytes = pos - table.back().offset;
+
+    align();
+    header.table = out.tellp();
+    header.nsections = table.size();
+    if (table.size())
+        out.write((const char *) &table[0], table.size() * sizeof(Cachefile::Section));
+
+    check();
+    out.close();
+
+    // the header goes in last with the hash of what follows it
+    int fd = ::open(tmpfile.c_str(), O_RDWR);
+    struct stat st;
+    void *m = MAP_FAILED;
+    if (fd != -1 and fstat(fd, &st) == 0)
+        m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        if (fd != -1) ::close(fd);
+        remove(tmpfile.c_str());
+        std::string errmsg = "Cachewriter - can not read back '" + tmpfile + "'.";
+        throw std::runtime_error(errmsg);
+    }
+    header.check = Cachefile::hash((const char *) m + sizeof(header),
+                                   st.st_size - sizeof(header));
+    munmap(m, st.st_size);
+
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+              and fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) {
+        remove(tmpfile.c_str());
+        std::string errmsg = "Cachewriter - error writing '" + tmpfile + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    if (rename(tmpfile.c_str(), file.c_str())) {
+        remove(tmpfile.c_str());
+        std::string errmsg = "Cachewriter - can not rename '" + tmpfile + "'.";
+        throw std::runtime_error(errmsg);
+    }
+}
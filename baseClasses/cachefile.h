@@ -0,0 +1,142 @@
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A cache file is a binary sidecar of an instance file that holds what
+// the problem derives from it, so a later load can map it instead of
+// parsing and computing it again. The file is a header, the sections and
+// a table of the sections at the end:
+//
+//     char     magic[4]   "VRPC"
+//     uint32_t format     version of this layout
+//     uint32_t kind       which problem wrote it
+//     uint32_t version    version of what the problem put in it
+//     uint64_t key        hash of the source file and the settings used
+//     uint64_t table      offset of the section table
+//     uint32_t nsections
+//     uint32_t reserved
+//     uint64_t check      hash of everything after the header
+//
+// Each table entry is an id, the offset and the size of a section. The
+// sections start on 64 byte boundaries so arrays can be used in place.
+// A problem usually stores one array per node attribute, that is the
+// nodes as a structure of arrays.
+//
+// Cachefile::open() only accepts a file with the same kind, version and
+// key whose contents still hash to check, anything else is a stale or
+// damaged cache and the problem rebuilds it with a Cachewriter. The
+// writer writes to a temporary file of its own in the same directory and
+// renames it when done, so readers never see a partial cache and jobs
+// that write the same cache at once do not mix their data.
+
+class Cachefile {
+  public:
+    struct Header {
+        char magic[4];
+        uint32_t format;
+        uint32_t kind;
+        uint32_t version;
+        uint64_t key;
+        uint64_t table;
+        uint32_t nsections;
+        uint32_t reserved;
+        uint64_t check;
+    };
+
+    struct Section {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+  private:
+    void *map;
+    size_t mapbytes;
+    const Section *table;
+    int nsections;
+
+    Cachefile(const Cachefile&);
+    Cachefile& operator=(const Cachefile&);
+
+  public:
+    // accessors
+    bool isopen() const { return map != NULL; };
+
+    // section id, NULL if there is none, its size goes in *bytes
+    const void* section(uint32_t id, size_t *bytes=NULL) const;
+
+    // section id as count values of T, NULL if it is missing or has
+    // another size
+    template <class T> const T* array(uint32_t id, size_t count) const {
+        size_t bytes;
+        const void *p = section(id, &bytes);
+        if (!p or bytes != count * sizeof(T)) return NULL;
+        return (const T *) p;
+    };
+
+    // FNV-1a hash of the contents of file, and of more bytes after it
+    static uint64_t hash(const std::string &file);
+    static uint64_t hash(uint64_t h, const void *data, size_t bytes);
+    // FNV-1a hash of bytes in memory
+    static uint64_t hash(const void *data, size_t bytes);
+
+    // mutators
+
+    // map file if it is a cache of kind and version made with key,
+    // false if not
+    bool open(const std::string &file, uint32_t kind, uint32_t version,
+              uint64_t key);
+    void close();
+
+    // structors
+    Cachefile() {
+        map = NULL;
+        mapbytes = 0;
+        table = NULL;
+        nsections = 0;
+    };
+
+    ~Cachefile() { close(); };
+
+};
+
+
+class Cachewriter {
+  private:
+    std::string file;
+    std::string tmpfile;
+    std::ofstream out;
+    Cachefile::Header header;
+    std::vector<Cachefile::Section> table;
+
+    void align();
+    void check();
+
+  public:
+    // the data of section id is what gets written to the stream up to
+    // the next begin() or commit()
+    std::ostream& begin(uint32_t id);
+
+    template <class T> void add(uint32_t id, const std::vector<T> &v) {
+        begin(id);
+        if (v.size())
+            out.write((const char *) &v[0], v.size() * sizeof(T));
+    };
+
+    // write the table and put the file in place
+    void commit();
+
+    // structors
+    Cachewriter(const std::string &_file, uint32_t kind, uint32_t version,
+                uint64_t key);
+    ~Cachewriter();
+
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef DISTPROVIDER_H
+#define DISTPROVIDER_H
+
+// Distprovider is what the problems ask for the cost of going from node
+// i to node j, where i and j are the positions of the nodes in the
+// problem's node table. Our vehicles drive at unit speed so the value is
+// used both as the distance and as the travel time, it can be a euclidean
+// distance (Dmatrix) or road network travel times computed offline and
+// read from a matrix file (Mmatrix).
+//
+// A problem that is given a provider does not own it, the provider has
+// to live as long as the problem uses it.
+
+class Distprovider {
+  public:
+    virtual int size() const = 0;
+    virtual double distance(int i, int j) const = 0;
+
+    virtual ~Distprovider() {};
+};
+
+#endif
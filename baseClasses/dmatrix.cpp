@@ -0,0 +1,485 @@
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "dmatrix.h"
+
+// rows and columns in a build tile
+const int TILE = 64;
+
+size_t Dmatrix::cells() const {
+    if (layout == FULL)
+        return (size_t) n * n;
+    if (layout == ONDEMAND)
+        return 0;
+    return (size_t) n * (n + 1) / 2;
+}
+
+
+size_t Dmatrix::bytes() const {
+    // the cells of an attached matrix belong to the mapped file
+    if (ext) return 0;
+    if (layout == ONDEMAND)
+        return (xs.size() + ys.size() + rows.size()) * sizeof(double);
+    // FULL may have room for more nodes
+    switch (precision) {
+        case DOUBLE: return dvals.size() * sizeof(double);
+        case FLOAT:  return fvals.size() * sizeof(float);
+        default:     return ivals.size() * sizeof(int);
+    }
+}
+
+
+void Dmatrix::setstorage(Layout _layout, Precision _precision, double _scale) {
+    clear();
+    layout = _layout;
+    precision = _precision;
+    scale = _scale;
+}
+
+
+void Dmatrix::set(int i, int j, double d) {
+    if (ext) {
+        std::string errmsg = "Dmatrix::set - attached matrices are read only.";
+        throw std::runtime_error(errmsg);
+    }
+    if (layout == ONDEMAND) {
+        std::string errmsg = "Dmatrix::set - ONDEMAND matrices do not store cells.";
+        throw std::runtime_error(errmsg);
+    }
+    size_t k = index(i, j);
+    // the FULL layout also has to mirror the cell
+    size_t m = index(j, i);
+    switch (precision) {
+        case DOUBLE:
+            dvals[k] = dvals[m] = d;
+            break;
+        case FLOAT:
+            fvals[k] = fvals[m] = (float) d;
+            break;
+        default:
+            ivals[k] = ivals[m] = (int) floor(d / scale + 0.5);
+            break;
+    }
+}
+
+
+void Dmatrix::resize(int _n) {
+    n = _n;
+    stride = n;
+    ext = NULL;
+    dvals.clear();
+    fvals.clear();
+    ivals.clear();
+    if (layout == ONDEMAND) {
+        setcachebytes(cachebytes);
+        return;
+    }
+    switch (precision) {
+        case DOUBLE: dvals.resize(cells(), 0.0); break;
+        case FLOAT:  fvals.resize(cells(), 0.0); break;
+        default:     ivals.resize(cells(), 0);   break;
+    }
+}
+
+
+void Dmatrix::clear() {
+    n = 0;
+    stride = 0;
+    ext = NULL;
+    // swap to really release the memory
+    std::vector<double>().swap(dvals);
+    std::vector<float>().swap(fvals);
+    std::vector<int>().swap(ivals);
+    std::vector<double>().swap(xs);
+    std::vector<double>().swap(ys);
+    std::vector<double>().swap(rows);
+    rowslot.clear();
+    slotrow.clear();
+    lruprev.clear();
+    lrunext.clear();
+    lruhead = lrutail = -1;
+}
+
+
+void Dmatrix::attach(const Mmatrix &m) {
+    if (!m.isopen()) {
+        std::string errmsg = "Dmatrix::attach - the matrix file is not open.";
+        throw std::runtime_error(errmsg);
+    }
+    clear();
+    n = m.size();
+    layout = FULL;
+    switch (m.getdtype()) {
+        case Mmatrix::DOUBLE: precision = DOUBLE; break;
+        case Mmatrix::FLOAT:  precision = FLOAT;  break;
+        default:              precision = SCALED; break;
+    }
+    scale = m.getscale();
+    ext = &m;
+}
+
+
+void Dmatrix::load(const Distprovider &d) {
+    int nn = d.size();
+    layout = FULL;
+    if (precision == SCALED and scale <= 0.0) {
+        double maxd = 0.0;
+        for (int i=0; i<nn; i++)
+            for (int j=0; j<nn; j++)
+                maxd = std::max(maxd, d.distance(i, j));
+        scale = maxd > 0.0 ? maxd / 2.0e9 : 1.0;
+    }
+    resize(nn);
+
+    // not through set(), it would mirror the cells
+    for (int i=0; i<nn; i++)
+        for (int j=0; j<nn; j++)
+            setcell(index(i, j), d.distance(i, j));
+}
+
+
+void Dmatrix::writecells(std::ostream &out) const {
+    if (layout != PACKED or ext) {
+        std::string errmsg = "Dmatrix::writecells - only PACKED matrices are written as cells.";
+        throw std::runtime_error(errmsg);
+    }
+    switch (precision) {
+        case DOUBLE: out.write((const char *) &dvals[0], dvals.size() * sizeof(double)); break;
+        case FLOAT:  out.write((const char *) &fvals[0], fvals.size() * sizeof(float)); break;
+        default:     out.write((const char *) &ivals[0], ivals.size() * sizeof(int)); break;
+    }
+}
+
+
+void Dmatrix::readcells(int _n, double _scale, const void *data, size_t bytes) {
+    if (layout != PACKED) {
+        std::string errmsg = "Dmatrix::readcells - only PACKED matrices are read as cells.";
+        throw std::runtime_error(errmsg);
+    }
+    resize(_n);
+    scale = _scale;
+    void *to;
+    size_t need;
+    switch (precision) {
+        case DOUBLE: to = &dvals[0]; need = dvals.size() * sizeof(double); break;
+        case FLOAT:  to = &fvals[0]; need = fvals.size() * sizeof(float); break;
+        default:     to = &ivals[0]; need = ivals.size() * sizeof(int); break;
+    }
+    if (bytes != need) {
+        clear();
+        std::string errmsg = "Dmatrix::readcells - the cells do not match the matrix.";
+        throw std::runtime_error(errmsg);
+    }
+    memcpy(to, data, bytes);
+}
+
+
+// copy the rows of a FULL block with row length from into one with row
+// length to
+template <class T>
+static void restride(std::vector<T> &v, int n, int from, int to) {
+    std::vector<T> w((size_t) to * to, 0);
+    for (int i=0; i<n; i++)
+        std::copy(v.begin() + (size_t) i * from,
+                  v.begin() + (size_t) i * from + n,
+                  w.begin() + (size_t) i * to);
+    v.swap(w);
+}
+
+
+// add nodes up to _n keeping the cells of the existing ones
+void Dmatrix::grow(int _n) {
+    if (ext) detach();
+
+    if (layout == ONDEMAND) {
+        n = _n;
+        xs.resize(n, 0.0);
+        ys.resize(n, 0.0);
+        setcachebytes(cachebytes);
+        return;
+    }
+
+    if (layout == FULL and _n > stride) {
+        // a quarter more than needed keeps the moves rare
+        int to = _n + _n / 4 + 1;
+        switch (precision) {
+            case DOUBLE: restride(dvals, n, stride, to); break;
+            case FLOAT:  restride(fvals, n, stride, to); break;
+            default:     restride(ivals, n, stride, to); break;
+        }
+        stride = to;
+    }
+
+    n = _n;
+    if (layout == FULL) return;
+
+    // the new rows go at the end of the PACKED block
+    switch (precision) {
+        case DOUBLE: dvals.resize(cells(), 0.0); break;
+        case FLOAT:  fvals.resize(cells(), 0.0); break;
+        default:     ivals.resize(cells(), 0);   break;
+    }
+}
+
+
+// copy the cells of the attached matrix so they can be changed
+void Dmatrix::detach() {
+    const Mmatrix *m = ext;
+    ext = NULL;
+    load(*m);
+}
+
+
+void Dmatrix::setrow(int i, const double *to, const double *from,
+                     double x, double y) {
+    if (i < 0 or i > n) {
+        std::string errmsg = "Dmatrix::setrow - row out of range.";
+        throw std::runtime_error(errmsg);
+    }
+    if (i == n)
+        grow(n + 1);
+    else if (ext)
+        detach();
+
+    if (layout == ONDEMAND) {
+        xs[i] = x;
+        ys[i] = y;
+        // the cached rows hold the old distances to i
+        if (cachedrows())
+            setcachebytes(cachebytes);
+        return;
+    }
+
+    // not through set(), it would mirror the cells
+    for (int j=0; j<n; j++) {
+        setcell(index(i, j), to[j]);
+        if (layout == FULL)
+            setcell(index(j, i), from[j]);
+    }
+}
+
+
+void Dmatrix::setcell(size_t k, double d) {
+    switch (precision) {
+        case DOUBLE: dvals[k] = d; break;
+        case FLOAT:  fvals[k] = (float) d; break;
+        default:     ivals[k] = (int) floor(d / scale + 0.5); break;
+    }
+}
+
+
+int Dmatrix::cachedrows() const {
+    int cnt = 0;
+    for (int s=0; s<slotrow.size(); s++)
+        if (slotrow[s] != -1) cnt++;
+    return cnt;
+}
+
+
+void Dmatrix::setcachebytes(size_t _cachebytes) {
+    cachebytes = _cachebytes;
+    if (layout != ONDEMAND) return;
+
+    // drop everything that is cached and size the slots for the new cap
+    size_t rowbytes = (size_t) (n ? n : 1) * sizeof(double);
+    int nslots = cachebytes / rowbytes;
+    if (nslots < 1) nslots = 1;
+    if (nslots > n) nslots = n;
+
+    std::vector<double>().swap(rows);
+    rows.resize((size_t) nslots * n);
+    rowslot.assign(n, -1);
+    slotrow.assign(nslots, -1);
+    lruprev.assign(nslots, -1);
+    lrunext.assign(nslots, -1);
+    lruhead = lrutail = -1;
+
+    // all slots start out free at the tail of the list
+    for (int s=0; s<nslots; s++)
+        lrupush(s);
+}
+
+
+void Dmatrix::lruunlink(int s) {
+    if (lruprev[s] != -1) lrunext[lruprev[s]] = lrunext[s];
+    else lruhead = lrunext[s];
+    if (lrunext[s] != -1) lruprev[lrunext[s]] = lruprev[s];
+    else lrutail = lruprev[s];
+    lruprev[s] = lrunext[s] = -1;
+}
+
+
+// put slot s at the head of the LRU list
+void Dmatrix::lrupush(int s) {
+    lruprev[s] = -1;
+    lrunext[s] = lruhead;
+    if (lruhead != -1) lruprev[lruhead] = s;
+    lruhead = s;
+    if (lrutail == -1) lrutail = s;
+}
+
+
+void Dmatrix::prefetch(int i) {
+    if (layout != ONDEMAND or i < 0 or i >= n) return;
+
+    int s = rowslot[i];
+    if (s == -1) {
+        // reuse the least recently used slot
+        s = lrutail;
+        if (slotrow[s] != -1)
+            rowslot[slotrow[s]] = -1;
+        distances(xs[i], ys[i], &xs[0], &ys[0], n, &rows[(size_t) s * n]);
+        slotrow[s] = i;
+        rowslot[i] = s;
+    }
+    lruunlink(s);
+    lrupush(s);
+}
+
+
+void Dmatrix::distances(double x, double y, const double *xs,
+                        const double *ys, int n, double *out) {
+    int k = 0;
+#if defined(__AVX__)
+    __m256d vx = _mm256_set1_pd(x);
+    __m256d vy = _mm256_set1_pd(y);
+    for (; k+4<=n; k+=4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs+k), vx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys+k), vy);
+        __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        _mm256_storeu_pd(out+k, _mm256_sqrt_pd(d2));
+    }
+#elif defined(__SSE2__)
+    __m128d vx = _mm_set1_pd(x);
+    __m128d vy = _mm_set1_pd(y);
+    for (; k+2<=n; k+=2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs+k), vx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys+k), vy);
+        __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        _mm_storeu_pd(out+k, _mm_sqrt_pd(d2));
+    }
+#endif
+    for (; k<n; k++) {
+        double dx = xs[k] - x;
+        double dy = ys[k] - y;
+        out[k] = sqrt( dx*dx + dy*dy );
+    }
+}
+
+
+// store d[0..cnt) as the cells (i,j0) .. (i,j0+cnt-1) and their mirrors
+void Dmatrix::store(int i, int j0, const double *d, int cnt) {
+    size_t k = index(i, j0);
+    switch (precision) {
+        case DOUBLE:
+            for (int c=0; c<cnt; c++) dvals[k+c] = d[c];
+            break;
+        case FLOAT:
+            for (int c=0; c<cnt; c++) fvals[k+c] = (float) d[c];
+            break;
+        default:
+            for (int c=0; c<cnt; c++)
+                ivals[k+c] = (int) floor(d[c] / scale + 0.5);
+            break;
+    }
+
+    if (layout != FULL) return;
+
+    for (int c=0; c<cnt; c++) {
+        size_t m = index(j0+c, i);
+        switch (precision) {
+            case DOUBLE: dvals[m] = dvals[k+c]; break;
+            case FLOAT:  fvals[m] = fvals[k+c]; break;
+            default:     ivals[m] = ivals[k+c]; break;
+        }
+    }
+}
+
+
+// worker for build(), takes rows of tiles off *next until none are left
+void Dmatrix::buildTiles(const std::vector<double> &x, const std::vector<double> &y,
+                         std::atomic<int> *next) {
+    int ntiles = (n + TILE - 1) / TILE;
+    double buf[TILE];
+
+    while (true) {
+        // hand out the longest rows first to even out the threads
+        int bi = ntiles - 1 - next->fetch_add(1);
+        if (bi < 0) break;
+
+        int i0 = bi * TILE;
+        int i1 = std::min(n, i0 + TILE);
+        for (int bj=0; bj<=bi; bj++) {
+            int j0 = bj * TILE;
+            for (int i=i0; i<i1; i++) {
+                int cnt = std::min(j0 + TILE, i + 1) - j0;
+                if (cnt <= 0) continue;
+                distances(x[i], y[i], &x[j0], &y[j0], cnt, buf);
+                store(i, j0, buf, cnt);
+            }
+        }
+    }
+}
+
+
+void Dmatrix::build(const std::vector<double> &x, const std::vector<double> &y) {
+    int nn = x.size();
+
+    if (precision == SCALED and scale <= 0.0) {
+        // pick a scale so the longest possible distance fits in an int
+        double minx, miny, maxx, maxy;
+        minx = maxx = nn ? x[0] : 0.0;
+        miny = maxy = nn ? y[0] : 0.0;
+        for (int i=1; i<nn; i++) {
+            if (x[i] < minx) minx = x[i];
+            if (y[i] < miny) miny = y[i];
+            if (x[i] > maxx) maxx = x[i];
+            if (y[i] > maxy) maxy = y[i];
+        }
+        double diag = sqrt((maxx-minx)*(maxx-minx) + (maxy-miny)*(maxy-miny));
+        scale = diag > 0.0 ? diag / 2.0e9 : 1.0;
+    }
+
+    if (layout == ONDEMAND) {
+        xs = x;
+        ys = y;
+    }
+
+    resize(nn);
+    if (!nn or layout == ONDEMAND) return;
+
+    int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+    int ntiles = (nn + TILE - 1) / TILE;
+    if (nt < 1) nt = 1;
+    if (nt > ntiles) nt = ntiles;
+
+    std::atomic<int> counter(0);
+    std::vector<std::thread> workers;
+    for (int t=1; t<nt; t++)
+        workers.push_back(std::thread(&Dmatrix::buildTiles, this,
+                          std::cref(x), std::cref(y), &counter));
+    buildTiles(x, y, &counter);
+    for (int t=0; t<workers.size(); t++)
+        workers[t].join();
+}
+
+
+void Dmatrix::dump() const {
+    std::cout << "--------- dMatrix ------------" << std::endl;
+    for (int i=0; i<n; i++) {
+        for (int j=0; j<n; j++) {
+            std::cout << i << "\t" << j << "\t" << get(i, j) << std::endl;
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#ifndef DMATRIX_H
+#define DMATRIX_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "distprovider.h"
+#include "mmatrix.h"
+
+// Dmatrix is a symmetric distance matrix held in a single contiguous
+// block. The storage can be selected to trade precision for memory:
+//
+//   layout:    FULL     - n*n cells, row major
+//              PACKED   - one triangle only, n*(n+1)/2 cells
+//              ONDEMAND - no cells, distances are computed when asked for
+//   precision: DOUBLE - 8 bytes per cell
+//              FLOAT  - 4 bytes per cell
+//              SCALED - 4 bytes per cell, int32 multiples of scale
+//
+// The PACKED layout stores row i as the cells j<=i, which is the upper
+// triangle in column major order. Doing it this way means adding a node
+// only appends a row at the end of the block.
+//
+// build() splits the triangle into square tiles that are handed out to
+// worker threads. Each pair is computed once with a SIMD kernel and the
+// FULL layout gets the mirrored tile written at the same time.
+//
+// ONDEMAND is for instances too big to hold any matrix. It only keeps
+// the coordinates and a bounded LRU cache of whole rows. prefetch(i)
+// loads row i into the cache with the SIMD kernel. get() uses a cached
+// row of either node when there is one and otherwise computes the
+// distance directly. get() only reads the cache so it is safe to call
+// from several threads, prefetch() is not.
+//
+// attach() makes the matrix a FULL view of a memory mapped Mmatrix, for
+// travel times that come from a file instead of the coordinates. Nothing
+// is copied, the Mmatrix has to stay open while the Dmatrix is used.
+// Travel times on a road network are not symmetric and neither is a matrix
+// from attach() or load(), get(i, j) is the time from i to j.
+//
+// setrow() replaces the distances of one node or adds a node as row and
+// column n, the row and the column come separately and a FULL matrix
+// keeps both as they are. PACKED only appends to the block and FULL keeps its rows
+// stride cells apart with room to spare, so adding nodes one at a time
+// moves the existing cells only now and then. An attached matrix is
+// copied into cells of its own the first time it is changed.
+
+class Dmatrix : public Distprovider {
+  public:
+    enum Layout { FULL, PACKED, ONDEMAND };
+    enum Precision { DOUBLE, FLOAT, SCALED };
+
+  private:
+    int n;                      // number of nodes
+    Layout layout;
+    Precision precision;
+    double scale;               // distance of one SCALED unit
+    std::vector<double> dvals;  // used for DOUBLE
+    std::vector<float> fvals;   // used for FLOAT
+    std::vector<int> ivals;     // used for SCALED
+    int nthreads;               // threads used by build(), 0 = all cores
+    const Mmatrix *ext;         // attached matrix file, NULL if we own the cells
+    int stride;                 // allocated row length of the FULL layout
+
+    // ONDEMAND state
+    std::vector<double> xs;     // x of each node
+    std::vector<double> ys;     // y of each node
+    size_t cachebytes;          // memory cap for cached rows
+    std::vector<double> rows;   // cached rows, n doubles per slot
+    std::vector<int> rowslot;   // cache slot of each row, -1 if not cached
+    std::vector<int> slotrow;   // row held in each slot, -1 if free
+    std::vector<int> lruprev;   // LRU list of slots, most recent at head
+    std::vector<int> lrunext;
+    int lruhead;
+    int lrutail;
+
+    void lruunlink(int s);
+    void lrupush(int s);
+    double ondemand(int i, int j) const {
+        int s = rowslot[i];
+        if (s != -1) return rows[(size_t) s * n + j];
+        s = rowslot[j];
+        if (s != -1) return rows[(size_t) s * n + i];
+        double dx = xs[j] - xs[i];
+        double dy = ys[j] - ys[i];
+        return sqrt( dx*dx + dy*dy );
+    };
+
+    void store(int i, int j0, const double *d, int cnt);
+    void setcell(size_t k, double d);
+    void grow(int _n);
+    void detach();
+    void buildTiles(const std::vector<double> &x, const std::vector<double> &y,
+                    std::atomic<int> *next);
+
+    size_t index(int i, int j) const {
+        if (layout == FULL)
+            return (size_t) i * stride + j;
+        if (i < j) {
+            int t = i;
+            i = j;
+            j = t;
+        }
+        return (size_t) i * (i + 1) / 2 + j;
+    };
+
+  public:
+    // accessors
+    int size() const { return n; };
+    Layout getlayout() const { return layout; };
+    Precision getprecision() const { return precision; };
+    double getscale() const { return scale; };
+    size_t cells() const;
+    size_t bytes() const;
+    size_t getcachebytes() const { return cachebytes; };
+    int cachedrows() const;
+
+    double get(int i, int j) const {
+        if (ext) return ext->get(i, j);
+        if (layout == ONDEMAND) return ondemand(i, j);
+        size_t k = index(i, j);
+        switch (precision) {
+            case DOUBLE: return dvals[k];
+            case FLOAT:  return fvals[k];
+            default:     return ivals[k] * scale;
+        }
+    };
+
+    double distance(int i, int j) const { return get(i, j); };
+    bool isattached() const { return ext != NULL; };
+
+    void dump() const;
+
+    // distances from point x,y to each of the n points xs[k],ys[k]
+    static void distances(double x, double y, const double *xs,
+                          const double *ys, int n, double *out);
+
+    // mutators
+    void setstorage(Layout _layout, Precision _precision, double _scale=0.0);
+    void set(int i, int j, double d);
+    void resize(int _n);
+    void clear();
+    void setthreads(int _nthreads) { nthreads = _nthreads; };
+
+    // use the cells of m in place, until the next resize() or clear()
+    void attach(const Mmatrix &m);
+    // copy the n*n values of d into a FULL matrix, d need not be symmetric
+    void load(const Distprovider &d);
+
+    // the cells of a PACKED matrix as they are held, for a cache file, and
+    // back from what writecells() wrote for n nodes with scale
+    void writecells(std::ostream &out) const;
+    void readcells(int _n, double _scale, const void *data, size_t bytes);
+
+    // make to[j] the distance from node i at x,y to node j and from[j] the
+    // distance from j to i, for j in [0..n), i may be size() to add a node.
+    // ONDEMAND only uses x,y, PACKED holds one distance per pair and takes
+    // to[], FULL takes both. to and from may be the same array.
+    void setrow(int i, const double *to, const double *from,
+                double x=0.0, double y=0.0);
+
+    // ONDEMAND row cache
+    void setcachebytes(size_t _cachebytes);
+    void prefetch(int i);
+
+    // build the euclidean distances between the points x[i],y[i]
+    void build(const std::vector<double> &x, const std::vector<double> &y);
+
+    // structors
+    Dmatrix() {
+        n = 0;
+        layout = PACKED;
+        precision = DOUBLE;
+        scale = 0.0;
+        nthreads = 0;
+        ext = NULL;
+        stride = 0;
+        cachebytes = 64 * 1024 * 1024;
+        lruhead = lrutail = -1;
+    };
+
+    Dmatrix(Layout _layout, Precision _precision, double _scale=0.0) {
+        n = 0;
+        layout = _layout;
+        precision = _precision;
+        scale = _scale;
+        nthreads = 0;
+        ext = NULL;
+        stride = 0;
+        cachebytes = 64 * 1024 * 1024;
+        lruhead = lrutail = -1;
+    };
+
+};
+
+#endif
@@ -0,0 +1,162 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mmatrix.h"
+
+const char MAGIC[4] = { 'V', 'R', 'P', 'M' };
+const uint32_t VERSION = 1;
+
+size_t Mmatrix::cellbytes(Dtype dtype) {
+    switch (dtype) {
+        case DOUBLE: return sizeof(double);
+        case FLOAT:  return sizeof(float);
+        default:     return sizeof(int32_t);
+    }
+}
+
+
+void Mmatrix::open(const std::string &file) {
+    close();
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::string errmsg = "Mmatrix::open - can not open '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 or st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        std::string errmsg = "Mmatrix::open - '" + file + "' is not a matrix file.";
+        throw std::runtime_error(errmsg);
+    }
+
+    // a shared read only mapping, other processes mapping the file use
+    // the same pages
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        std::string errmsg = "Mmatrix::open - can not map '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    std::string errmsg = check(m, st.st_size);
+    if (errmsg.size()) {
+        munmap(m, st.st_size);
+        throw std::runtime_error("Mmatrix::open - '" + file + "' " + errmsg);
+    }
+
+    const Header *h = (const Header *) m;
+    map = m;
+    mapbytes = st.st_size;
+    n = h->n;
+    dtype = (Dtype) h->dtype;
+    scale = h->scale;
+    cells = (const char *) m + sizeof(Header);
+}
+
+
+void Mmatrix::view(const void *data, size_t bytes) {
+    close();
+
+    std::string errmsg = check(data, bytes);
+    if (errmsg.size())
+        throw std::runtime_error("Mmatrix::view - the matrix " + errmsg);
+
+    const Header *h = (const Header *) data;
+    n = h->n;
+    dtype = (Dtype) h->dtype;
+    scale = h->scale;
+    cells = (const char *) data + sizeof(Header);
+}
+
+
+std::string Mmatrix::check(const void *data, size_t bytes) {
+    const Header *h = (const Header *) data;
+    if (bytes < sizeof(Header) or memcmp(h->magic, MAGIC, sizeof(MAGIC)))
+        return "is not a matrix file.";
+    if (h->version != VERSION)
+        return "has an unknown version.";
+    if (h->dtype > SCALED)
+        return "has an unknown dtype.";
+    if (bytes != sizeof(Header) + (size_t) h->n * h->n * cellbytes((Dtype) h->dtype))
+        return "does not match its dimension.";
+    return "";
+}
+
+
+void Mmatrix::close() {
+    if (map)
+        munmap(map, mapbytes);
+    map = NULL;
+    mapbytes = 0;
+    cells = NULL;
+    n = 0;
+}
+
+
+void Mmatrix::write(const std::string &file, const Distprovider &d,
+                    Dtype dtype, double scale) {
+    std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::string errmsg = "Mmatrix::write - can not create '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    write(out, d, dtype, scale);
+
+    if (!out) {
+        std::string errmsg = "Mmatrix::write - error writing '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+}
+
+
+void Mmatrix::write(std::ostream &out, const Distprovider &d,
+                    Dtype dtype, double scale) {
+    int nn = d.size();
+
+    if (dtype == SCALED and scale <= 0.0) {
+        double maxd = 0.0;
+        for (int i=0; i<nn; i++)
+            for (int j=0; j<nn; j++)
+                maxd = std::max(maxd, d.distance(i, j));
+        scale = maxd > 0.0 ? maxd / 2.0e9 : 1.0;
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.n = nn;
+    h.dtype = dtype;
+    h.scale = dtype == SCALED ? scale : 0.0;
+    out.write((const char *) &h, sizeof(h));
+
+    // a row at a time
+    std::vector<char> row(nn * cellbytes(dtype));
+    for (int i=0; i<nn; i++) {
+        for (int j=0; j<nn; j++) {
+            double v = d.distance(i, j);
+            switch (dtype) {
+                case DOUBLE: ((double *) &row[0])[j] = v; break;
+                case FLOAT:  ((float *) &row[0])[j] = (float) v; break;
+                default:
+                    ((int32_t *) &row[0])[j] = (int32_t) floor(v / scale + 0.5);
+                    break;
+            }
+        }
+        if (nn) out.write(&row[0], row.size());
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef MMATRIX_H
+#define MMATRIX_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "distprovider.h"
+
+// Mmatrix is a read only n*n matrix memory mapped from a binary file,
+// the usual way to hand road network travel times to the solvers.
+// Opening a matrix file does not read it, the pages are brought in as
+// they are used and are shared by every process that maps the same file.
+//
+// The file is a 32 byte header followed by the n*n cells in row major
+// order, all in the byte order of the machine that wrote it:
+//
+//     char     magic[4]   "VRPM"
+//     uint32_t version    1
+//     uint32_t n          number of nodes
+//     uint32_t dtype      0 - double, 1 - float, 2 - int32 multiples of scale
+//     double   scale      distance of one unit for dtype 2
+//     uint32_t reserved[2]
+//
+// write() makes such a file from any Distprovider. Unlike Dmatrix the
+// matrix does not have to be symmetric. The same bytes can also be held
+// in memory mapped by someone else, a cache file for example, view()
+// uses them in place.
+
+class Mmatrix : public Distprovider {
+  public:
+    enum Dtype { DOUBLE=0, FLOAT=1, SCALED=2 };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t n;
+        uint32_t dtype;
+        double scale;
+        uint32_t reserved[2];
+    };
+
+  private:
+    int n;
+    Dtype dtype;
+    double scale;
+    void *map;              // the whole mapped file, NULL if not ours
+    size_t mapbytes;
+    const void *cells;      // first cell, right after the header
+
+    // the error for a matrix of bytes bytes at data, empty if it is good
+    static std::string check(const void *data, size_t bytes);
+
+    Mmatrix(const Mmatrix&);
+    Mmatrix& operator=(const Mmatrix&);
+
+  public:
+    // accessors
+    int size() const { return n; };
+    Dtype getdtype() const { return dtype; };
+    double getscale() const { return scale; };
+    const void* data() const { return cells; };
+    bool isopen() const { return cells != NULL; };
+
+    double get(int i, int j) const {
+        size_t k = (size_t) i * n + j;
+        switch (dtype) {
+            case DOUBLE: return ((const double *) cells)[k];
+            case FLOAT:  return ((const float *) cells)[k];
+            default:     return ((const int32_t *) cells)[k] * scale;
+        }
+    };
+    double distance(int i, int j) const { return get(i, j); };
+
+    static size_t cellbytes(Dtype dtype);
+
+    // write the matrix of d to file, SCALED with scale <= 0 picks a scale
+    // so the largest value fits in an int32
+    static void write(const std::string &file, const Distprovider &d,
+                      Dtype dtype, double scale=0.0);
+    static void write(std::ostream &out, const Distprovider &d,
+                      Dtype dtype, double scale=0.0);
+
+    // mutators
+    void open(const std::string &file);
+    // use a matrix someone else holds in memory, it is not copied
+    void view(const void *data, size_t bytes);
+    void close();
+
+    // structors
+    Mmatrix() {
+        n = 0;
+        dtype = DOUBLE;
+        scale = 0.0;
+        map = NULL;
+        mapbytes = 0;
+        cells = NULL;
+    };
+
+    Mmatrix(const std::string &file) {
+        n = 0;
+        dtype = DOUBLE;
+        scale = 0.0;
+        map = NULL;
+        mapbytes = 0;
+        cells = NULL;
+        open(file);
+    };
+
+    ~Mmatrix() { close(); };
+
+};
+
+#endif
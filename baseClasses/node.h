@@ -13,8 +13,8 @@ class Node {
   public:
     // accessors
     int getnid() const { return nid; };
-    int getx() const { return x; };
-    int gety() const { return y; };
+    double getx() const { return x; };
+    double gety() const { return y; };
 
     double distance(const Node &n) const {
         double dx = n.x - x;
@@ -0,0 +1,119 @@
+#ifndef NODESET_H
+#define NODESET_H
+
+#include <stdint.h>
+#include <vector>
+
+// Nodeset is a fixed size set of node indices kept as a bitset, 64 nodes
+// to a word. Sets are combined a word at a time and the members are
+// walked with count trailing zeros so only the set bits are visited:
+//
+//     for (int i=s.first(); i!=-1; i=s.next(i))
+//         ...
+//
+// The bits past size() in the last word are always zero.
+
+class Nodeset {
+  private:
+    int n;                          // number of nodes in the universe
+    std::vector<uint64_t> bits;
+
+    static int nwords(int n) { return (n + 63) / 64; };
+
+    // first set bit at or after word w, -1 if none
+    int scan(int w) const {
+        for (; w<bits.size(); w++)
+            if (bits[w])
+                return w * 64 + __builtin_ctzll(bits[w]);
+        return -1;
+    };
+
+  public:
+    // accessors
+    int size() const { return n; };
+
+    bool test(int i) const {
+        return (bits[i >> 6] >> (i & 63)) & 1;
+    };
+
+    int count() const {
+        int cnt = 0;
+        for (int w=0; w<bits.size(); w++)
+            cnt += __builtin_popcountll(bits[w]);
+        return cnt;
+    };
+
+    bool empty() const {
+        for (int w=0; w<bits.size(); w++)
+            if (bits[w]) return false;
+        return true;
+    };
+
+    int first() const { return scan(0); };
+
+    // raw words, for callers that combine several sets on the fly
+    int words() const { return bits.size(); };
+    uint64_t word(int w) const { return bits[w]; };
+    // the bits of word w that are inside the universe
+    uint64_t mask(int w) const {
+        if (w < (int) bits.size() - 1 or !(n & 63))
+            return ~(uint64_t) 0;
+        return ((uint64_t) 1 << (n & 63)) - 1;
+    };
+
+    // first member after i, -1 if none
+    int next(int i) const {
+        i++;
+        if (i >= n) return -1;
+        uint64_t rest = bits[i >> 6] >> (i & 63);
+        if (rest) return i + __builtin_ctzll(rest);
+        return scan((i >> 6) + 1);
+    };
+
+    // mutators
+    void resize(int _n) {
+        n = _n;
+        bits.assign(nwords(n), 0);
+    };
+
+    // make room for nodes up to _n, the members are kept
+    void grow(int _n) {
+        n = _n;
+        bits.resize(nwords(n), 0);
+    };
+
+    void set(int i) { bits[i >> 6] |= (uint64_t) 1 << (i & 63); };
+    void reset(int i) { bits[i >> 6] &= ~((uint64_t) 1 << (i & 63)); };
+
+    void clear() { bits.assign(bits.size(), 0); };
+
+    void fill() {
+        bits.assign(bits.size(), ~(uint64_t) 0);
+        if (n & 63)
+            bits.back() = ((uint64_t) 1 << (n & 63)) - 1;
+    };
+
+    Nodeset& operator|=(const Nodeset &s) {
+        for (int w=0; w<bits.size(); w++)
+            bits[w] |= s.bits[w];
+        return *this;
+    };
+
+    Nodeset& operator&=(const Nodeset &s) {
+        for (int w=0; w<bits.size(); w++)
+            bits[w] &= s.bits[w];
+        return *this;
+    };
+
+    // structors
+    Nodeset() {
+        n = 0;
+    };
+
+    Nodeset(int _n) {
+        resize(_n);
+    };
+
+};
+
+#endif
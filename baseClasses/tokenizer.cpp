@@ -0,0 +1,143 @@
+
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tokenizer.h"
+
+Tokenizer::Tokenizer(const std::string &file) {
+    name = file;
+    map = NULL;
+    mapbytes = 0;
+    cur = end = NULL;
+    lineno = 0;
+    comment = '#';
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::string errmsg = "Tokenizer - can not open '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        std::string errmsg = "Tokenizer - can not read '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+
+    // an empty file can not be mapped, it just has no lines
+    if (st.st_size > 0) {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            ::close(fd);
+            std::string errmsg = "Tokenizer - can not map '" + file + "'.";
+            throw std::runtime_error(errmsg);
+        }
+        madvise(m, st.st_size, MADV_SEQUENTIAL);
+        map = m;
+        mapbytes = st.st_size;
+        cur = (const char *) m;
+        end = cur + mapbytes;
+    }
+    ::close(fd);
+}
+
+
+Tokenizer::Tokenizer(const char *text, size_t len, const std::string &_name) {
+    name = _name;
+    map = NULL;
+    mapbytes = 0;
+    cur = text;
+    end = text + len;
+    lineno = 0;
+    comment = '#';
+}
+
+
+Tokenizer::~Tokenizer() {
+    if (map)
+        munmap(map, mapbytes);
+}
+
+
+bool Tokenizer::nextline() {
+    // skip what is left of the current line
+    if (lineno) {
+        while (cur < end and *cur != '\n') cur++;
+        if (cur < end) cur++;
+    }
+
+    while (cur < end) {
+        lineno++;
+        const char *p = cur;
+        while (p < end and (*p == ' ' or *p == '\t' or *p == '\r')) p++;
+        if (p < end and *p != '\n' and *p != comment) {
+            cur = p;
+            return true;
+        }
+        while (p < end and *p != '\n') p++;
+        cur = p < end ? p + 1 : p;
+    }
+    return false;
+}
+
+
+bool Tokenizer::eol() {
+    while (cur < end and (*cur == ' ' or *cur == '\t' or *cur == '\r')) cur++;
+    return cur == end or *cur == '\n';
+}
+
+
+// start of the next value on the line, after a '+' sign which from_chars
+// does not take
+const char* Tokenizer::token() {
+    if (eol())
+        error("missing value");
+    if (*cur == '+' and cur+1 < end and *(cur+1) != '-')
+        cur++;
+    return cur;
+}
+
+
+void Tokenizer::error(const char *what) const {
+    std::ostringstream errmsg;
+    errmsg << "Tokenizer - " << (name.size() ? name : "text") << ": line "
+           << lineno << ": " << what << ".";
+    throw std::runtime_error(errmsg.str());
+}
+
+
+// the value has to end at a blank or the end of the line
+template <class T> void Tokenizer::read(T &v) {
+    const char *p = token();
+    std::from_chars_result r = std::from_chars(p, end, v);
+    if (r.ec != std::errc() or (r.ptr < end and *r.ptr != ' '
+            and *r.ptr != '\t' and *r.ptr != '\r' and *r.ptr != '\n'))
+        error("expected a number");
+    cur = r.ptr;
+}
+
+
+Tokenizer& Tokenizer::operator>>(int &v) {
+    read(v);
+    return *this;
+}
+
+
+Tokenizer& Tokenizer::operator>>(long int &v) {
+    read(v);
+    return *this;
+}
+
+
+Tokenizer& Tokenizer::operator>>(double &v) {
+    read(v);
+    return *this;
+}
@@ -0,0 +1,64 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <cstddef>
+#include <string>
+
+// Tokenizer reads whitespace separated numbers out of a text without
+// copying it or allocating per line. A file is memory mapped as a whole,
+// a string is read in place. The numbers are parsed with std::from_chars
+// straight out of the text:
+//
+//     Tokenizer tk(file);
+//     while (tk.nextline())
+//         tk >> nid >> x >> y;
+//
+// nextline() skips blank lines and lines starting with the comment
+// character. Reading a value that is missing or is not a number throws a
+// std::runtime_error with the name of the text and the line number. What
+// is left of a line after the values that were read is ignored.
+
+class Tokenizer {
+  private:
+    std::string name;       // file name for the error messages
+    void *map;              // the mapped file, NULL for a string
+    size_t mapbytes;
+    const char *cur;        // next character to read
+    const char *end;
+    int lineno;             // current line, 1 based, 0 before the first
+    char comment;
+
+    Tokenizer(const Tokenizer&);
+    Tokenizer& operator=(const Tokenizer&);
+
+    const char* token();
+    template <class T> void read(T &v);
+    void error(const char *what) const;
+
+  public:
+    // accessors
+    int line() const { return lineno; };
+    const std::string& getname() const { return name; };
+
+    // true if there are no more values on the current line
+    bool eol();
+
+    // mutators
+
+    // move to the next line with data on it, false at the end of the text
+    bool nextline();
+
+    Tokenizer& operator>>(int &v);
+    Tokenizer& operator>>(long int &v);
+    Tokenizer& operator>>(double &v);
+
+    void setcomment(char c) { comment = c; };
+
+    // structors
+    Tokenizer(const std::string &file);
+    Tokenizer(const char *text, size_t len, const std::string &_name="");
+    ~Tokenizer();
+
+};
+
+#endif
@@ -1,6 +1,5 @@
 
 #include <iostream>
-#include <sstream>
 #include <string>
 
 #include "twnode.h"
@@ -40,20 +39,15 @@ void Twnode::set(int _nid, double _x, double _y, int _demand,
 
 Twnode::Twnode(std::string line) {
     // TODO: extend this to support pickup and delivery pairs
+    Tokenizer tk(line.data(), line.size());
+    tk.nextline();
+    tk >> nid >> x >> y >> demand >> tw_open >> tw_close >> service;
+}
+
 
-    //int pid;
-    //int did;
-
-    std::istringstream buffer( line );
-    buffer >> nid;
-    buffer >> x;
-    buffer >> y;
-    buffer >> demand;
-    buffer >> tw_open;
-    buffer >> tw_close;
-    buffer >> service;
-    //buffer >> pid;
-    //buffer >> did;
+// read the values of the current line of tk
+Twnode::Twnode(Tokenizer &tk) {
+    tk >> nid >> x >> y >> demand >> tw_open >> tw_close >> service;
 }
 
 
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "node.h"
+#include "tokenizer.h"
 
 class Twnode: public Node {
   protected:
@@ -75,7 +76,9 @@ class Twnode: public Node {
         service = _service;
     };
 
+    // nid x y demand tw_open tw_close service
     Twnode(std::string line);
+    Twnode(Tokenizer &tk);
 
     ~Twnode() {};
 
@@ -29,18 +29,22 @@ template <class knode> class Twpath {
 
     Twpath& operator=(const Twpath& n) {
         home = n.home;
+        dumpsite = n.dumpsite;
         path = n.path;
         return *this;
     };
 
     knode& getdepot() { return home; };
     knode& getdumpsite() { return dumpsite; };
+    const knode& getdepot() const { return home; };
+    const knode& getdumpsite() const { return dumpsite; };
 
     void setdepot(knode& n) { home = n; };
     void setdumpsite(knode& n) { dumpsite = n; };
 
     // element access
     knode& operator[](unsigned int n) { return path[n]; };
+    const knode& operator[](unsigned int n) const { return path[n]; };
     knode& at(int n) { return path.at(n); };
     knode& front() { return path.front(); };
     knode& back() { return path.back(); };
@@ -0,0 +1,97 @@
+#ifndef PATHIDX_H
+#define PATHIDX_H
+
+#include <deque>
+#include <vector>
+#include <iostream>
+
+/*
+    Twpathidx has the same interface as Twpath but it does not copy the
+    nodes. It holds a pointer to the node table of the problem that owns
+    the nodes and keeps only the index of each node in that table, so a
+    node must have its index in the table as its nid.
+
+    Copying a path or inserting into it only moves ints around and any
+    number of paths (or whole solutions) can share the same node data.
+    The element accessors return const references into the table, the
+    nodes themselves are only changed through the owning problem.
+*/
+
+template <class knode> class Twpathidx {
+  protected:
+    const std::vector<knode> *nodes;    // node table the indices refer to
+    int home;                           // index of the depot
+    int dumpsite;                       // index of the dump
+    std::deque<int> path;               // indices of the stops
+
+    const knode& node(int i) const { return (*nodes)[path[i]]; };
+
+  public:
+
+    typedef typename std::deque<int> nodepath;
+    typedef typename std::deque<int>::iterator iterator;
+    typedef typename std::deque<int>::const_iterator const_iterator;
+
+    // structors
+    Twpathidx() {
+        nodes = NULL;
+        home = -1;
+        dumpsite = -1;
+    };
+
+    Twpathidx(const std::vector<knode> &_nodes) {
+        nodes = &_nodes;
+        home = -1;
+        dumpsite = -1;
+    };
+
+    // accessors
+    const std::vector<knode>& getnodes() const { return *nodes; };
+    const knode& getdepot() const { return (*nodes)[home]; };
+    const knode& getdumpsite() const { return (*nodes)[dumpsite]; };
+    int getnid(int i) const { return path[i]; };
+    const nodepath& getnids() const { return path; };
+
+    void setnodes(const std::vector<knode> &_nodes) { nodes = &_nodes; };
+    void setdepot(const knode& n) { home = n.getnid(); };
+    void setdumpsite(const knode& n) { dumpsite = n.getnid(); };
+
+    // element access
+    const knode& operator[](unsigned int n) const { return node(n); };
+    const knode& at(int n) const { return (*nodes)[path.at(n)]; };
+    const knode& front() const { return (*nodes)[path.front()]; };
+    const knode& back() const { return (*nodes)[path.back()]; };
+
+    // iterators, these walk over the indices
+    iterator begin() { return path.begin(); };
+    iterator end() { return path.end(); };
+    const_iterator begin() const { return path.begin(); };
+    const_iterator end() const { return path.end(); };
+
+    // Capacity
+    unsigned int size() const { return path.size(); };
+    unsigned int max_size() const { return path.max_size(); };
+    bool empty() const { return path.empty(); };
+
+    // modifiers
+    void push_back(const knode& n) { path.push_back(n.getnid()); };
+    void push_front(const knode& n) { path.push_front(n.getnid()); };
+    void pop_back() { path.pop_back(); };
+    void pop_front() { path.pop_front(); };
+    iterator insert(iterator it, const knode& n) { return path.insert(it, n.getnid()); };
+    iterator erase(iterator it) { return path.erase(it); };
+    void clear() { path.clear(); };
+
+    void dump() const {
+        std::cout << "Path: " << home;
+        for (int i=0; i<path.size(); i++)
+            std::cout << ", " << path[i];
+        std::cout << ", " << dumpsite
+                  << ", " << home
+                  << std::endl;
+    };
+
+};
+
+
+#endif
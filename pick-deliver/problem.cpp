@@ -82,16 +82,21 @@ Order& Problem::getOrder(int i) {
 }
 
 double Problem::DepotToDelivery(int n1) const {
+    if (dp and n1>=0 && n1 < N.size())
+        return dp->distance(depot.getnid(), N[n1].getdid());
     return  (n1>=0 && n1 <= N.size()) ? N[N[n1].getdid()].distance(depot):-1;
     //return N[N[n1].did].distance(depot);
 }
 
 double Problem::DepotToPickup(int n1) const {
+    if (dp and n1>=0 && n1 < N.size())
+        return dp->distance(depot.getnid(), n1);
     return  (n1>=0 && n1 <= N.size()) ? N[n1].distance(depot):-1;
     //return N[n1].distance(depot);
 }
 
 double Problem::distance(int n1,int n2) const {
+    if (dp) return dp->distance(n1, n2);
     return N[n1].distance(N[n2]);
 /*    double dx = N[n2].x - N[n1].x;
     double dy = N[n2].y - N[n1].y;
@@ -203,6 +208,11 @@ void Problem::loadProblem(char *infile)
 
     in.close();
 
+    if (dp and dp->size() != N.size()) {
+        std::string errmsg = "Problem::loadProblem - the distance provider does not match the number of nodes.";
+        throw std::runtime_error(errmsg);
+    }
+
     // add a small buffer around the extents
     extents[0] -= (extents[2] - extents[0]) * 0.02;
     extents[2] += (extents[2] - extents[0]) * 0.02;
@@ -9,6 +9,7 @@
 #include <deque>
 #include <math.h>
 
+#include "distprovider.h"
 #include "node.h"
 #include "order.h"
 class Solution;
@@ -33,7 +34,11 @@ class Problem {
     // variables for plotting
     double extents[4]; 
 
-    // Problem() {};
+    // travel times between the nodes, NULL to use the euclidean distance
+    // row i is the node with nid i, the provider is not owned by the problem
+    const Distprovider *dp;
+
+    Problem() { dp = NULL; };
     // ~Problem() {};
 
     Node &getdepot(){ return depot;};
@@ -45,6 +50,7 @@ class Problem {
     unsigned int getOrderCount();
 
     double distance(int n1, int n2) const;
+    void setDistances(const Distprovider *_dp) { dp = _dp; };
     double DepotToPickup(int n1) const ;
     double DepotToDelivery(int n1) const ;
     int getOrderOid(int i) const;
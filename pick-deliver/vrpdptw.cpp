@@ -8,6 +8,7 @@
 #include <vector>
 #include <math.h>
 
+#include "mmatrix.h"
 #include "node.h"
 #include "order.h"
 #include "problem.h"
@@ -24,7 +25,7 @@ static Problem P;
 
 void Usage()
 {
-    std::cout << "Usage: vrpdptw in.txt\n";
+    std::cout << "Usage: vrpdptw in.txt [matrix.mtx]\n";
 }
 
 
@@ -39,6 +40,13 @@ int main (int argc, char **argv)
     
     try {
         std::string title;
+        // road network travel times instead of euclidean distances
+        Mmatrix times;
+        if (argc > 2) {
+            times.open(argv[2]);
+            P.setDistances(&times);
+        }
+
         P.loadProblem(infile);
         std::cout << "Problem '" << infile << "'loaded\n";
         P.dump();
@@ -0,0 +1,187 @@
+
+#include "interroute.h"
+
+// smallest improvement we bother with
+const double EPS = 1e-7;
+
+void Interroute::mark(const Vehicle &v, char s) {
+    for (int i=0; i<v.size(); i++) {
+        pos[v.getnid(i)] = i;
+        side[v.getnid(i)] = s;
+    }
+}
+
+
+void Interroute::unmark(const Vehicle &v) {
+    for (int i=0; i<v.size(); i++) {
+        pos[v.getnid(i)] = -1;
+        side[v.getnid(i)] = 0;
+    }
+}
+
+
+// move a pickup of a next to one of its neighbors in b
+// taking a stop out of a route never makes it late anywhere, so only b
+// has to be checked for time window violations
+bool Interroute::relocate(Vehicle &a, Vehicle &b, char sb) {
+    int room = b.getmaxcapacity() - b.getcurcapacity();
+
+    for (int i=0; i<a.size(); i++) {
+        int x = a.getnid(i);
+        if (nodes[x].getdemand() > room) continue;
+
+        int pa = prev(a, i);
+        int na = next(a, i);
+        double gain = d(pa, x) + d(x, na) - d(pa, na);
+        if (gain <= EPS) continue;
+
+        const std::vector<int> &nb = neighbors[x];
+        for (int k=0; k<nb.size(); k++) {
+            int c = nb[k];
+            if (side[c] != sb) continue;
+            int j = pos[c];
+
+            // before or after c
+            for (int q=j; q<=j+1; q++) {
+                int p = q == j ? prev(b, j) : c;
+                int n = q == j ? c : next(b, j);
+                if (d(p, x) + d(x, n) - d(p, n) >= gain - EPS) continue;
+
+                int tw;
+                b.testInsert(nodes[x], q, NULL, &tw);
+                if (tw > b.getTWV()) continue;
+
+                a.erase(a.begin()+i);
+                b.insert(b.begin()+q, nodes[x]);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// exchange a pickup of a with one of its neighbors in b
+bool Interroute::swap(Vehicle &a, Vehicle &b) {
+    for (int i=0; i<a.size(); i++) {
+        int x = a.getnid(i);
+        int pa = prev(a, i);
+        int na = next(a, i);
+
+        const std::vector<int> &nb = neighbors[x];
+        for (int k=0; k<nb.size(); k++) {
+            int y = nb[k];
+            if (side[y] != 2) continue;
+            int j = pos[y];
+
+            int diff = nodes[y].getdemand() - nodes[x].getdemand();
+            if (a.getcurcapacity() + diff > a.getmaxcapacity()
+                    or b.getcurcapacity() - diff > b.getmaxcapacity())
+                continue;
+
+            int pb = prev(b, j);
+            int nn = next(b, j);
+            double delta = d(pa, y) + d(y, na) - d(pa, x) - d(x, na)
+                         + d(pb, x) + d(x, nn) - d(pb, y) - d(y, nn);
+            if (delta >= -EPS) continue;
+
+            int twa, twb;
+            a.testReplace(nodes[y], i, NULL, &twa);
+            b.testReplace(nodes[x], j, NULL, &twb);
+            if (twa + twb > a.getTWV() + b.getTWV())
+                continue;
+
+            a.erase(a.begin()+i);
+            a.insert(a.begin()+i, nodes[y]);
+            b.erase(b.begin()+j);
+            b.insert(b.begin()+j, nodes[x]);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// 2-opt*: link a pickup ai of a to a neighbor c in b and swap the rest of
+// the routes, a becomes a[..i] b[j..] and b becomes b[..j-1] a[i+1..]
+// where j is the position of c. Each route keeps its own dump.
+bool Interroute::twoOptStar(Vehicle &a, Vehicle &b, char sb) {
+    int dumpa = a.getdumpsite().getnid();
+    int dumpb = b.getdumpsite().getnid();
+    int lasta = a.getnid(a.size()-1);
+    int lastb = b.getnid(b.size()-1);
+
+    for (int i=0; i<a.size(); i++) {
+        int ai = a.getnid(i);
+        int sai = next(a, i);
+        bool tailless = i == a.size()-1;
+
+        const std::vector<int> &nb = neighbors[ai];
+        for (int k=0; k<nb.size(); k++) {
+            int c = nb[k];
+            if (side[c] != sb) continue;
+            int j = pos[c];
+            int pc = prev(b, j);
+
+            int heada = a.getload(i);
+            int headb = j ? b.getload(j-1) : 0;
+            if (heada + b.getcurcapacity() - headb > a.getmaxcapacity()
+                    or headb + a.getcurcapacity() - heada > b.getmaxcapacity())
+                continue;
+
+            double before = d(ai, sai) + d(pc, c) + d(lastb, dumpb)
+                          + (tailless ? 0.0 : d(lasta, dumpa));
+            double after = d(ai, c) + d(lastb, dumpa)
+                         + (tailless ? d(pc, dumpb) : d(pc, sai) + d(lasta, dumpb));
+            if (after - before >= -EPS) continue;
+
+            int twa, twb;
+            a.testTail(i+1, b, j, NULL, &twa);
+            b.testTail(j, a, i+1, NULL, &twb);
+            if (twa + twb > a.getTWV() + b.getTWV())
+                continue;
+
+            Vehicle ta = a;
+            Vehicle tb = b;
+            ta.clear();
+            tb.clear();
+            for (int m=0; m<=i; m++) ta.push_back(nodes[a.getnid(m)]);
+            for (int m=j; m<b.size(); m++) ta.push_back(nodes[b.getnid(m)]);
+            for (int m=0; m<j; m++) tb.push_back(nodes[b.getnid(m)]);
+            for (int m=i+1; m<a.size(); m++) tb.push_back(nodes[a.getnid(m)]);
+
+            a = ta;
+            b = tb;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// apply improving moves between a and b until there are none left,
+// returns the number of moves
+int Interroute::improve(Vehicle &a, Vehicle &b) {
+    int moves = 0;
+
+    mark(a, 1);
+    mark(b, 2);
+
+    while (true) {
+        bool moved = relocate(a, b, 2) or relocate(b, a, 1)
+                     or (a.size() and b.size() and (swap(a, b)
+                         or twoOptStar(a, b, 2) or twoOptStar(b, a, 1)));
+        if (!moved) break;
+        moves++;
+
+        // the pickups only moved between a and b
+        unmark(a);
+        unmark(b);
+        mark(a, 1);
+        mark(b, 2);
+    }
+
+    unmark(a);
+    unmark(b);
+    return moves;
+}
@@ -0,0 +1,66 @@
+#ifndef INTERROUTE_H
+#define INTERROUTE_H
+
+#include <vector>
+
+#include "dmatrix.h"
+#include "trashnode.h"
+#include "vehicle.h"
+
+// Interroute improves a pair of routes by moving pickups between them:
+//
+//     relocate - move a pickup into the other route
+//     swap     - exchange a pickup of each route
+//     2-opt*   - exchange the tails of the two routes
+//
+// Like Routeopt the candidate moves come from the k nearest neighbor
+// lists, a pickup is only moved next to one of its neighbors in the other
+// route. The change in distance of a move is computed from the edges it
+// touches and the loads from the prefix loads kept by Vehicle, so only
+// moves that pass both are looked at. A move is applied only if the
+// routes do not end up with more time window violations, which is checked
+// with Vehicle::testInsert(), testReplace() and testTail() from the state
+// the routes keep at each stop, the routes are only changed for a move
+// that is taken.
+//
+// It only keeps state for the two routes it works on, so pairs that do
+// not share a route can be improved at the same time by separate
+// instances.
+
+class Interroute {
+  private:
+    const std::vector<Trashnode> &nodes;
+    const Dmatrix &dm;
+    const std::vector< std::vector<int> > &neighbors;
+
+    std::vector<int> pos;       // position of each nid in its route
+    std::vector<char> side;     // 0 - not in the pair, 1 - in a, 2 - in b
+
+    double d(int a, int b) const { return dm.get(a, b); };
+    int prev(const Vehicle &v, int i) const {
+        return i == 0 ? v.getdepot().getnid() : v.getnid(i-1);
+    };
+    int next(const Vehicle &v, int i) const {
+        return i == v.size()-1 ? v.getdumpsite().getnid() : v.getnid(i+1);
+    };
+    void mark(const Vehicle &v, char s);
+    void unmark(const Vehicle &v);
+    bool relocate(Vehicle &a, Vehicle &b, char sb);
+    bool swap(Vehicle &a, Vehicle &b);
+    bool twoOptStar(Vehicle &a, Vehicle &b, char sb);
+
+  public:
+    // mutators
+    int improve(Vehicle &a, Vehicle &b);
+
+    // structors
+    Interroute(const std::vector<Trashnode> &_nodes, const Dmatrix &_dm,
+               const std::vector< std::vector<int> > &_neighbors)
+        : nodes(_nodes), dm(_dm), neighbors(_neighbors) {
+        pos.resize(nodes.size(), -1);
+        side.resize(nodes.size(), 0);
+    };
+
+};
+
+#endif
@@ -0,0 +1,284 @@
+
+#include <algorithm>
+
+#include "routeopt.h"
+
+// smallest improvement we bother with
+const double EPS = 1e-7;
+
+double Routeopt::getlength() const {
+    double len = 0.0;
+    for (int k=1; k<seq.size(); k++)
+        len += d(seq[k-1], seq[k]);
+    return len;
+}
+
+
+void Routeopt::load(const std::vector<int> &_seq) {
+    for (int k=0; k<seq.size(); k++)
+        pos[seq[k]] = -1;
+
+    seq = _seq;
+    start.resize(seq.size());
+    dep.resize(seq.size());
+    late.resize(seq.size());
+    fwd.resize(seq.size());
+    bwd.resize(seq.size());
+
+    // only the pickups get a position, the depot is on both ends
+    for (int k=1; k<(int)seq.size()-2; k++)
+        pos[seq[k]] = k;
+
+    schedule(0);
+}
+
+
+// recompute the schedule of the route from position from to its end
+// this follows the same rules as Vehicle::evaluate()
+void Routeopt::schedule(int from) {
+    int last = seq.size() - 1;
+
+    if (from == 0) {
+        start[0] = dep[0] = 0.0;
+        late[0] = 0;
+        fwd[0] = bwd[0] = 0.0;
+        from = 1;
+    }
+
+    for (int k=from; k<=last; k++) {
+        const Trashnode &n = nodes[seq[k]];
+        double t = dep[k-1] + d(seq[k-1], seq[k]);
+        if (k < last and n.earlyarrival(t))
+            t = n.opens();
+        late[k] = late[k-1] + (n.latearrival(t) ? 1 : 0);
+        start[k] = t;
+        dep[k] = k < last ? t + n.getservicetime() : t;
+        fwd[k] = fwd[k-1] + d(seq[k-1], seq[k]);
+        bwd[k] = bwd[k-1] + d(seq[k], seq[k-1]);
+    }
+}
+
+
+// change in length if seq[l..r] was reversed
+double Routeopt::reverseDelta(int l, int r) const {
+    return d(seq[l-1], seq[r]) + d(seq[l], seq[r+1])
+         - d(seq[l-1], seq[l]) - d(seq[r], seq[r+1]) + reversal(l, r);
+}
+
+
+// would replacing seq[l..r] with mid add any TW violations
+bool Routeopt::feasible(int l, const std::vector<int> &mid, int r) const {
+    if (!checktw) return true;
+
+    int last = seq.size() - 1;
+    double t = dep[l-1];
+    int prev = seq[l-1];
+    int newlate = 0;
+
+    for (int m=0; m<mid.size(); m++) {
+        const Trashnode &n = nodes[mid[m]];
+        t += d(prev, mid[m]);
+        if (n.earlyarrival(t)) t = n.opens();
+        if (n.latearrival(t)) newlate++;
+        t += n.getservicetime();
+        prev = mid[m];
+    }
+
+    for (int k=r+1; k<=last; k++) {
+        const Trashnode &n = nodes[seq[k]];
+        t += d(prev, seq[k]);
+        if (k < last and n.earlyarrival(t)) t = n.opens();
+        // from here on the new schedule is the same as the old one
+        if (t == start[k])
+            return newlate <= late[k-1] - late[l-1];
+        if (n.latearrival(t)) newlate++;
+        if (k < last) t += n.getservicetime();
+        prev = seq[k];
+    }
+
+    return newlate <= late[last] - late[l-1];
+}
+
+
+void Routeopt::apply(int l, const std::vector<int> &mid) {
+    for (int m=0; m<mid.size(); m++) {
+        seq[l+m] = mid[m];
+        pos[mid[m]] = l+m;
+    }
+    schedule(l);
+}
+
+
+void Routeopt::wake(int nid) {
+    if (pos[nid] == -1 or !dontlook[nid]) return;
+    dontlook[nid] = 0;
+    active.push_back(nid);
+}
+
+
+// 2-opt: replace two edges by linking a to one of its neighbors c
+bool Routeopt::try2opt(int a) {
+    int i = pos[a];
+    int pa = seq[i-1];
+    int sa = seq[i+1];
+    double dpred = d(pa, a);
+    double dsucc = d(a, sa);
+    const std::vector<int> &nb = neighbors[a];
+    std::vector<int> mid;
+
+    for (int k=0; k<nb.size(); k++) {
+        int c = nb[k];
+        double dac = d(a, c);
+        // the lists are sorted so no later neighbor can help
+        if (dac >= dsucc and dac >= dpred) break;
+        if (pos[c] == -1) continue;
+        int j = pos[c];
+
+        // new edges (a,c) and (sa,sc)
+        int sc = seq[j+1];
+        if (dac < dsucc and c != sa and sc != a) {
+            int l = std::min(i, j) + 1;
+            int r = std::max(i, j);
+            double delta = reverseDelta(l, r);
+            if (delta < -EPS) {
+                mid.assign(seq.rbegin() + (seq.size() - 1 - r),
+                           seq.rbegin() + (seq.size() - l));
+                if (feasible(l, mid, r)) {
+                    apply(l, mid);
+                    wake(a); wake(sa); wake(c); wake(sc);
+                    return true;
+                }
+            }
+        }
+
+        // new edges (a,c) and (pa,pc)
+        int pc = seq[j-1];
+        if (dac < dpred and c != pa and pc != a) {
+            int l = std::min(i, j);
+            int r = std::max(i, j) - 1;
+            double delta = reverseDelta(l, r);
+            if (delta < -EPS) {
+                mid.assign(seq.rbegin() + (seq.size() - 1 - r),
+                           seq.rbegin() + (seq.size() - l));
+                if (feasible(l, mid, r)) {
+                    apply(l, mid);
+                    wake(a); wake(pa); wake(c); wake(pc);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+
+// Or-opt: move the 1 to 3 nodes starting at a next to a neighbor c
+bool Routeopt::tryOropt(int a) {
+    int s = pos[a];
+    const std::vector<int> &nb = neighbors[a];
+    std::vector<int> mid;
+
+    for (int len=1; len<=3; len++) {
+        int e = s + len - 1;
+        if (e >= (int)seq.size() - 2) break;
+
+        int p = seq[s-1];
+        int nx = seq[e+1];
+        double gain = d(p, seq[s]) + d(seq[e], nx) - d(p, nx);
+        if (gain <= EPS) continue;
+
+        for (int k=0; k<nb.size(); k++) {
+            int c = nb[k];
+            if (d(a, c) >= gain) break;
+            if (pos[c] == -1) continue;
+            int j = pos[c];
+            if (j >= s and j <= e) continue;
+
+            // insert as c, s..e, cn
+            int cn = seq[j+1];
+            if (j != s-1) {
+                double delta = d(c, seq[s]) + d(seq[e], cn) - d(c, cn) - gain;
+                if (delta < -EPS) {
+                    int l, r;
+                    mid.clear();
+                    if (j < s) {
+                        l = j + 1;
+                        r = e;
+                        mid.insert(mid.end(), seq.begin()+s, seq.begin()+e+1);
+                        mid.insert(mid.end(), seq.begin()+j+1, seq.begin()+s);
+                    }
+                    else {
+                        l = s;
+                        r = j;
+                        mid.insert(mid.end(), seq.begin()+e+1, seq.begin()+j+1);
+                        mid.insert(mid.end(), seq.begin()+s, seq.begin()+e+1);
+                    }
+                    if (feasible(l, mid, r)) {
+                        int se = seq[e];
+                        apply(l, mid);
+                        wake(p); wake(nx); wake(c); wake(cn); wake(a); wake(se);
+                        return true;
+                    }
+                }
+            }
+
+            // insert reversed as pc, e..s, c
+            int pc = seq[j-1];
+            if (j != e+1) {
+                double delta = d(pc, seq[e]) + d(seq[s], c) - d(pc, c) - gain
+                             + reversal(s, e);
+                if (delta < -EPS) {
+                    int l, r;
+                    mid.clear();
+                    if (j < s) {
+                        l = j;
+                        r = e;
+                        mid.insert(mid.end(), seq.rbegin() + (seq.size() - 1 - e),
+                                   seq.rbegin() + (seq.size() - s));
+                        mid.insert(mid.end(), seq.begin()+j, seq.begin()+s);
+                    }
+                    else {
+                        l = s;
+                        r = j - 1;
+                        mid.insert(mid.end(), seq.begin()+e+1, seq.begin()+j);
+                        mid.insert(mid.end(), seq.rbegin() + (seq.size() - 1 - e),
+                                   seq.rbegin() + (seq.size() - s));
+                    }
+                    if (feasible(l, mid, r)) {
+                        int se = seq[e];
+                        apply(l, mid);
+                        wake(p); wake(nx); wake(c); wake(pc); wake(a); wake(se);
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+
+// run 2-opt and Or-opt until no node can be improved
+// returns the number of moves that were applied
+int Routeopt::optimize() {
+    int moves = 0;
+
+    active.clear();
+    for (int k=1; k<(int)seq.size()-2; k++) {
+        dontlook[seq[k]] = 0;
+        active.push_back(seq[k]);
+    }
+
+    while (!active.empty()) {
+        int a = active.back();
+        active.pop_back();
+        dontlook[a] = 1;
+
+        if (try2opt(a) or tryOropt(a)) {
+            moves++;
+            wake(a);
+        }
+    }
+
+    return moves;
+}
@@ -0,0 +1,83 @@
+#ifndef ROUTEOPT_H
+#define ROUTEOPT_H
+
+#include <vector>
+
+#include "dmatrix.h"
+#include "trashnode.h"
+
+// Routeopt improves the order of a single route with 2-opt and Or-opt
+// moves. The route is a sequence of nids
+//
+//     depot, pickup, ..., pickup, dump, depot
+//
+// and only the pickups are moved. Candidate moves come from the k nearest
+// neighbor lists of each pickup so we never look at all pairs. The change
+// in distance of a move is computed in constant time from the four or six
+// edges it touches, and nodes that did not lead to an improvement are
+// marked "don't look" until one of their edges changes.
+//
+// Travel times need not be symmetric. A move that reverses a segment also
+// changes the cost of the edges inside it, we keep the length of the route
+// up to each position both ways so that is constant time too.
+//
+// Improving moves are only accepted if they do not add time window
+// violations. We keep the schedule of the current route so a move only
+// needs to be simulated from its first changed position, and we stop as
+// soon as the new schedule catches up with the old one.
+
+class Routeopt {
+  private:
+    const std::vector<Trashnode> &nodes;
+    const Dmatrix &dm;
+    const std::vector< std::vector<int> > &neighbors;
+    bool checktw;               // reject moves that add TW violations
+
+    std::vector<int> seq;       // nids along the route
+    std::vector<int> pos;       // position in seq of each nid, -1 if not in it
+    std::vector<double> start;  // time service starts at each position
+    std::vector<double> dep;    // time we leave each position
+    std::vector<int> late;      // number of TW violations up to each position
+    std::vector<double> fwd;    // length of the route up to each position
+    std::vector<double> bwd;    // the same going the other way
+    std::vector<char> dontlook; // don't look bit of each nid
+    std::vector<int> active;    // nids whose don't look bit is off
+
+    double d(int a, int b) const { return dm.get(a, b); };
+    bool ispickup(int nid) const {
+        int k = pos[nid];
+        return k > 0 and k < seq.size() - 2;
+    };
+    void schedule(int from);
+    double reversal(int l, int r) const {
+        return bwd[r] - bwd[l] - (fwd[r] - fwd[l]);
+    };
+    double reverseDelta(int l, int r) const;
+    bool feasible(int l, const std::vector<int> &mid, int r) const;
+    void apply(int l, const std::vector<int> &mid);
+    void wake(int nid);
+    bool try2opt(int a);
+    bool tryOropt(int a);
+
+  public:
+    // accessors
+    const std::vector<int> &getseq() const { return seq; };
+    double getlength() const;
+
+    // mutators
+    void settwcheck(bool _checktw) { checktw = _checktw; };
+    void load(const std::vector<int> &_seq);
+    int optimize();
+
+    // structors
+    Routeopt(const std::vector<Trashnode> &_nodes, const Dmatrix &_dm,
+             const std::vector< std::vector<int> > &_neighbors)
+        : nodes(_nodes), dm(_dm), neighbors(_neighbors) {
+        checktw = true;
+        pos.resize(nodes.size(), -1);
+        dontlook.resize(nodes.size(), 1);
+    };
+
+};
+
+#endif
@@ -0,0 +1,178 @@
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "segmentindex.h"
+
+int SegmentIndex::cellx(double x) const {
+    int c = (int) floor((x - minx) / cellsize);
+    if (c < 0) return 0;
+    if (c >= nx) return nx-1;
+    return c;
+}
+
+
+int SegmentIndex::celly(double y) const {
+    int c = (int) floor((y - miny) / cellsize);
+    if (c < 0) return 0;
+    if (c >= ny) return ny-1;
+    return c;
+}
+
+
+void SegmentIndex::build(const std::vector<Trashnode> &nodes,
+                         const std::vector<int> &nids) {
+    clear();
+
+    px.resize(nodes.size());
+    py.resize(nodes.size());
+    cellof.resize(nodes.size(), -1);
+    for (int i=0; i<nodes.size(); i++) {
+        px[i] = nodes[i].getx();
+        py[i] = nodes[i].gety();
+    }
+
+    if (nids.empty()) return;
+
+    // get the extents of the nodes we are indexing
+    double maxx, maxy;
+    minx = maxx = px[nids[0]];
+    miny = maxy = py[nids[0]];
+    for (int i=1; i<nids.size(); i++) {
+        if (px[nids[i]] < minx) minx = px[nids[i]];
+        if (py[nids[i]] < miny) miny = py[nids[i]];
+        if (px[nids[i]] > maxx) maxx = px[nids[i]];
+        if (py[nids[i]] > maxy) maxy = py[nids[i]];
+    }
+
+    // size the cells to hold about two nodes each
+    double w = maxx - minx;
+    double h = maxy - miny;
+    if (w < 1.0) w = 1.0;
+    if (h < 1.0) h = 1.0;
+    cellsize = sqrt(w * h / (nids.size() / 2.0 + 1.0));
+    nx = (int) (w / cellsize) + 1;
+    ny = (int) (h / cellsize) + 1;
+
+    cells.resize(nx * ny);
+    for (int i=0; i<nids.size(); i++) {
+        int nid = nids[i];
+        int c = celly(py[nid])*nx + cellx(px[nid]);
+        cells[c].push_back(nid);
+        cellof[nid] = c;
+        count++;
+    }
+}
+
+
+void SegmentIndex::nearestToPoint(double x, double y, int k, int skip,
+                                  std::vector<int> &out) const {
+    std::vector< std::pair<double, int> > cand;
+    out.clear();
+    if (!count or k <= 0) return;
+
+    // cells already scanned in the previous pass
+    int px0 = 0, px1 = -1, py0 = 0, py1 = -1;
+
+    // grow the search box until the k-th nearest is inside of it
+    double r = cellsize;
+    while (true) {
+        int cx0 = cellx(x - r);
+        int cx1 = cellx(x + r);
+        int cy0 = celly(y - r);
+        int cy1 = celly(y + r);
+
+        for (int cy=cy0; cy<=cy1; cy++) {
+            for (int cx=cx0; cx<=cx1; cx++) {
+                if (cx >= px0 and cx <= px1 and cy >= py0 and cy <= py1)
+                    continue;
+                const std::vector<int> &cell = cells[cy*nx + cx];
+                for (int i=0; i<cell.size(); i++) {
+                    int nid = cell[i];
+                    if (nid == skip) continue;
+                    double dx = px[nid] - x;
+                    double dy = py[nid] - y;
+                    cand.push_back(std::make_pair(sqrt(dx*dx + dy*dy), nid));
+                }
+            }
+        }
+
+        if (cand.size() >= k) {
+            std::nth_element(cand.begin(), cand.begin()+k-1, cand.end());
+            if (cand[k-1].first <= r) break;
+        }
+        if (cx0 == 0 and cy0 == 0 and cx1 == nx-1 and cy1 == ny-1) break;
+
+        px0 = cx0; px1 = cx1;
+        py0 = cy0; py1 = cy1;
+        r *= 2.0;
+    }
+
+    int m = std::min(k, (int) cand.size());
+    std::partial_sort(cand.begin(), cand.begin()+m, cand.end());
+    for (int i=0; i<m; i++)
+        out.push_back(cand[i].second);
+}
+
+
+void SegmentIndex::remove(int nid) {
+    if (!contains(nid)) return;
+
+    std::vector<int> &cell = cells[cellof[nid]];
+    for (int k=0; k<cell.size(); k++) {
+        if (cell[k] == nid) {
+            cell[k] = cell.back();
+            cell.pop_back();
+            break;
+        }
+    }
+    cellof[nid] = -1;
+    count--;
+}
+
+
+void SegmentIndex::clear() {
+    cells.clear();
+    cellof.clear();
+    px.clear();
+    py.clear();
+    count = 0;
+    nx = ny = 0;
+    routeid = -1;
+    segnid.clear();
+    segdist.clear();
+}
+
+
+bool SegmentIndex::cachevalid(int rid, int selector, int demandLimit,
+                              int nseg) const {
+    if (rid != routeid or selector != cselector or nseg != segnid.size())
+        return false;
+    // a larger demandLimit lets in nodes that were rejected before
+    if (demandLimit > climit)
+        return false;
+    return true;
+}
+
+
+void SegmentIndex::resetSegments(int rid, int selector, int demandLimit,
+                                 int nseg) {
+    routeid = rid;
+    cselector = selector;
+    climit = demandLimit;
+    segnid.assign(nseg, -1);
+    segdist.assign(nseg, 0.0);
+}
+
+
+void SegmentIndex::insertSegment(int pos) {
+    if (pos < 0 or pos >= segnid.size()) {
+        routeid = -1;
+        return;
+    }
+    // segment pos is replaced by two new segments pos and pos+1
+    segnid.insert(segnid.begin()+pos, -1);
+    segdist.insert(segdist.begin()+pos, 0.0);
+    segnid[pos+1] = -1;
+}
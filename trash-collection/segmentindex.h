@@ -0,0 +1,157 @@
+#ifndef SEGMENTINDEX_H
+#define SEGMENTINDEX_H
+
+#include <vector>
+
+#include "vec2d.h"
+#include "trashnode.h"
+
+// SegmentIndex buckets node locations into a uniform grid so we can find
+// the node closest to a line segment by only looking at the cells around
+// the segment's bounding box, instead of scanning every node.
+//
+// Nodes are removed from the grid as they get assigned, so the grid only
+// ever holds candidates.
+//
+// It also caches the nearest node found for each segment of the route
+// being built. When a node is inserted at pos, segment pos is split into
+// two and only those two need to be searched again. A cached answer stays
+// correct as long as the candidate set only shrinks, which is the case
+// while we keep the same selector and a non-increasing demandLimit.
+
+class SegmentIndex {
+  private:
+    double minx;
+    double miny;
+    double cellsize;
+    int nx;
+    int ny;
+    std::vector< std::vector<int> > cells;  // nids bucketed by grid cell
+    std::vector<int> cellof;                // cell of each nid, -1 if not in grid
+    std::vector<double> px;                 // x location of each nid
+    std::vector<double> py;                 // y location of each nid
+    int count;                              // number of nids in the grid
+
+    // nearest node cache for the route being built
+    int routeid;                // depot nid of the cached route
+    int cselector;              // selector used to fill the cache
+    int climit;                 // demandLimit used to fill the cache
+    std::vector<int> segnid;    // nearest nid per segment, -1 stale, -2 none
+    std::vector<double> segdist;// distance from segnid to its segment
+
+    int cellx(double x) const;
+    int celly(double y) const;
+
+  public:
+    // accessors
+    bool isbuilt() const { return !cells.empty(); };
+    bool contains(int nid) const {
+        return nid >= 0 and nid < cellof.size() and cellof[nid] != -1;
+    };
+    int size() const { return count; };
+
+    // return the nid nearest to segment a-b that is not rejected
+    // by filter(nid), or -1 if there is none, and set *dist
+    template <class Filter>
+    int nearestToSegment(const Trashnode &a, const Trashnode &b,
+                         Filter &filter, double *dist) const;
+
+    // set out to the k nids nearest to x,y in order of distance
+    // leaving out the nid skip
+    void nearestToPoint(double x, double y, int k, int skip,
+                        std::vector<int> &out) const;
+
+    // segment cache, demandLimit should be 0 when it is not used
+    bool cachevalid(int rid, int selector, int demandLimit, int nseg) const;
+    void resetSegments(int rid, int selector, int demandLimit, int nseg);
+    void insertSegment(int pos);
+    int getsegnid(int j) const { return segnid[j]; };
+    double getsegdist(int j) const { return segdist[j]; };
+    void setsegment(int j, int nid, double dist) {
+        segnid[j] = nid == -1 ? -2 : nid;
+        segdist[j] = dist;
+    };
+
+    // mutators
+    void build(const std::vector<Trashnode> &nodes, const std::vector<int> &nids);
+    void remove(int nid);
+    void clear();
+
+    // structors
+    SegmentIndex() {
+        minx = miny = 0.0;
+        cellsize = 1.0;
+        nx = ny = 0;
+        count = 0;
+        routeid = -1;
+        cselector = -1;
+        climit = 0;
+    };
+
+};
+
+
+template <class Filter>
+int SegmentIndex::nearestToSegment(const Trashnode &a, const Trashnode &b,
+                                   Filter &filter, double *dist) const {
+    int nn = -1;        // init to not found
+    double best = -1;   // dist to nn
+    double qx, qy;
+
+    if (!count) {
+        *dist = best;
+        return nn;
+    }
+
+    double x1 = a.getx();
+    double y1 = a.gety();
+    double x2 = b.getx();
+    double y2 = b.gety();
+    double bx0 = x1 < x2 ? x1 : x2;
+    double bx1 = x1 < x2 ? x2 : x1;
+    double by0 = y1 < y2 ? y1 : y2;
+    double by1 = y1 < y2 ? y2 : y1;
+
+    // cells already scanned in the previous pass
+    int px0 = 0, px1 = -1, py0 = 0, py1 = -1;
+
+    // grow the search box around the segment until the best node found
+    // is closer than anything that can lie outside of the box
+    double r = cellsize;
+    while (true) {
+        int cx0 = cellx(bx0 - r);
+        int cx1 = cellx(bx1 + r);
+        int cy0 = celly(by0 - r);
+        int cy1 = celly(by1 + r);
+
+        for (int cy=cy0; cy<=cy1; cy++) {
+            for (int cx=cx0; cx<=cx1; cx++) {
+                if (cx >= px0 and cx <= px1 and cy >= py0 and cy <= py1)
+                    continue;
+                const std::vector<int> &cell = cells[cy*nx + cx];
+                for (int k=0; k<cell.size(); k++) {
+                    int nid = cell[k];
+                    if (filter(nid)) continue;
+                    double d = distanceFromLineSegmentToPoint(
+                        x1, y1, x2, y2, px[nid], py[nid], &qx, &qy);
+                    if (nn == -1 or d < best or (d == best and nid < nn)) {
+                        best = d;
+                        nn = nid;
+                    }
+                }
+            }
+        }
+
+        if (nn != -1 and best <= r) break;
+        if (cx0 == 0 and cy0 == 0 and cx1 == nx-1 and cy1 == ny-1) break;
+
+        px0 = cx0; px1 = cx1;
+        py0 = cy0; py1 = cy1;
+        r *= 2.0;
+    }
+
+    *dist = best;
+    return nn;
+}
+
+#endif
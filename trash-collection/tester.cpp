@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -11,10 +12,14 @@
 #include "vec2d.h"
 #include <stdio.h>
 
+#include "dmatrix.h"
+#include "mmatrix.h"
 #include "node.h"
 #include "twnode.h"
 #include "trashnode.h"
 #include "twpath.h"
+#include "vehicle.h"
+#include "routeopt.h"
 #include "trashproblem.h"
 
 void TestDistanceFromLineSegmentToPoint( double segmentX1, double segmentY1, double segmentX2, double segmentY2, double pX, double pY ) {
@@ -34,10 +39,222 @@ void TestDistanceFromLineSegmentToPoint() {
     TestDistanceFromLineSegmentToPoint( 0, 0, 0, 10, 1, 5 );
 }
 
+void TestDmatrix() {
+    std::vector<double> x;
+    std::vector<double> y;
+    for (int i=0; i<20; i++) {
+        x.push_back(i * 3.5);
+        y.push_back(10.0 - i * i * 0.75);
+    }
+
+    Dmatrix full(Dmatrix::FULL, Dmatrix::DOUBLE);
+    full.build(x, y);
+
+    Dmatrix::Layout layouts[] = { Dmatrix::FULL, Dmatrix::PACKED };
+    Dmatrix::Precision precisions[] = { Dmatrix::DOUBLE, Dmatrix::FLOAT, Dmatrix::SCALED };
+    for (int l=0; l<2; l++) {
+        for (int p=0; p<3; p++) {
+            Dmatrix dm(layouts[l], precisions[p]);
+            dm.build(x, y);
+            double maxerr = 0.0;
+            for (int i=0; i<x.size(); i++)
+                for (int j=0; j<x.size(); j++)
+                    maxerr = std::max(maxerr, fabs(dm.get(i, j) - full.get(i, j)));
+            printf( "Dmatrix layout = %d, precision = %d, bytes = %d, max error = %g\n",
+                    l, p, (int) dm.bytes(), maxerr );
+        }
+    }
+
+    // matrix free with room for 3 cached rows
+    Dmatrix od(Dmatrix::ONDEMAND, Dmatrix::DOUBLE);
+    od.setcachebytes(3 * x.size() * sizeof(double));
+    od.build(x, y);
+    for (int i=0; i<5; i++)
+        od.prefetch(i);
+    double maxerr = 0.0;
+    for (int i=0; i<x.size(); i++)
+        for (int j=0; j<x.size(); j++)
+            maxerr = std::max(maxerr, fabs(od.get(i, j) - full.get(i, j)));
+    printf( "Dmatrix ONDEMAND cached rows = %d, bytes = %d, max error = %g\n",
+            od.cachedrows(), (int) od.bytes(), maxerr );
+}
+
+void TestMmatrix() {
+    std::vector<double> x;
+    std::vector<double> y;
+    for (int i=0; i<20; i++) {
+        x.push_back(i * 3.5);
+        y.push_back(10.0 - i * i * 0.75);
+    }
+
+    Dmatrix full(Dmatrix::FULL, Dmatrix::DOUBLE);
+    full.build(x, y);
+
+    std::string file = "tester.mtx";
+    Mmatrix::Dtype dtypes[] = { Mmatrix::DOUBLE, Mmatrix::FLOAT, Mmatrix::SCALED };
+    for (int t=0; t<3; t++) {
+        Mmatrix::write(file, full, dtypes[t]);
+        Mmatrix mm(file);
+        Dmatrix dm;
+        dm.attach(mm);
+        double maxerr = 0.0;
+        for (int i=0; i<x.size(); i++)
+            for (int j=0; j<x.size(); j++)
+                maxerr = std::max(maxerr, fabs(dm.get(i, j) - full.get(i, j)));
+        printf( "Mmatrix dtype = %d, n = %d, attached bytes = %d, max error = %g\n",
+                t, mm.size(), (int) dm.bytes(), maxerr );
+    }
+    remove(file.c_str());
+}
+
+// euclidean distances that take longer one way than the other
+class Skewed : public Distprovider {
+  private:
+    const std::vector<Trashnode> &nodes;
+
+  public:
+    int size() const { return nodes.size(); };
+    double distance(int i, int j) const {
+        return nodes[i].distance(nodes[j]) * (i < j ? 1.0 : 1.4);
+    };
+
+    Skewed(const std::vector<Trashnode> &_nodes) : nodes(_nodes) {};
+};
+
+static bool sameEvaluation(double c, double d, int tw, int cv, const Vehicle &w) {
+    return fabs(c - w.getcost()) < 1e-9 and fabs(d - w.getduration()) < 1e-9
+           and tw == w.getTWV() and cv == w.getCV();
+}
+
+// The incremental tests of a Vehicle have to agree with evaluating the
+// changed route from scratch, and Routeopt with Vehicle, when the travel
+// times are not symmetric.
+void TestAsymmetric() {
+    std::vector<Trashnode> nodes;
+    nodes.push_back(Trashnode(0, 0, 0, 100, 0, 24*60, 0, 0));
+    nodes.push_back(Trashnode(1, 40, 40, 0, 0, 24*60, 30, 1));
+    for (int i=2; i<16; i++) {
+        double x = 5 + (i * 37) % 50;
+        double y = 5 + (i * 53) % 45;
+        int open = (i * 71) % 200;
+        nodes.push_back(Trashnode(i, x, y, 10, open, open + 120, 5, 2));
+    }
+
+    Skewed skewed(nodes);
+    Dmatrix dm(Dmatrix::FULL, Dmatrix::DOUBLE);
+    dm.load(skewed);
+
+    Vehicle a(nodes);
+    Vehicle b(nodes);
+    Vehicle *v[2] = { &a, &b };
+    for (int k=0; k<2; k++) {
+        v[k]->setdepot(nodes[0]);
+        v[k]->setdumpsite(nodes[1]);
+        v[k]->setdmatrix(&dm);
+        v[k]->evaluate();
+    }
+    for (int i=2; i<16; i++)
+        v[i % 2]->push_back(nodes[i]);
+
+    int checks = 0;
+    int wrong = 0;
+    double c, d;
+    int tw, cv;
+
+    checks++;
+    if (fabs(a.getarrival(0) - dm.get(0, a.getnid(0))) > 1e-9) wrong++;
+
+    for (int pos=0; pos<=a.size(); pos++) {
+        for (int j=0; j<b.size(); j++) {
+            const Trashnode &n(nodes[b.getnid(j)]);
+
+            c = a.testInsert(n, pos, &d, &tw, &cv);
+            Vehicle w(a);
+            w.insert(w.begin()+pos, n);
+            checks++;
+            if (!sameEvaluation(c, d, tw, cv, w)) wrong++;
+
+            if (pos == a.size()) continue;
+            c = a.testReplace(n, pos, &d, &tw, &cv);
+            Vehicle r(a);
+            r.erase(r.begin()+pos);
+            r.insert(r.begin()+pos, n);
+            checks++;
+            if (!sameEvaluation(c, d, tw, cv, r)) wrong++;
+        }
+
+        for (int from=0; from<=b.size(); from++) {
+            c = a.testTail(pos, b, from, &d, &tw, &cv);
+            Vehicle t(a);
+            while (t.size() > pos)
+                t.erase(t.begin()+pos);
+            for (int j=from; j<b.size(); j++)
+                t.push_back(nodes[b.getnid(j)]);
+            checks++;
+            if (!sameEvaluation(c, d, tw, cv, t)) wrong++;
+        }
+    }
+
+    // Routeopt may only make the route shorter without adding violations
+    std::vector< std::vector<int> > neighbors(nodes.size());
+    for (int i=2; i<nodes.size(); i++)
+        for (int j=2; j<nodes.size(); j++)
+            if (i != j) neighbors[i].push_back(j);
+
+    Vehicle all(nodes);
+    all.setdepot(nodes[0]);
+    all.setdumpsite(nodes[1]);
+    all.setdmatrix(&dm);
+    all.evaluate();
+    for (int i=15; i>=2; i--)
+        all.push_back(nodes[i]);
+
+    std::vector<int> seq;
+    seq.push_back(0);
+    for (int i=0; i<all.size(); i++)
+        seq.push_back(all.getnid(i));
+    seq.push_back(1);
+    seq.push_back(0);
+
+    Routeopt ro(nodes, dm, neighbors);
+    ro.load(seq);
+    double before = ro.getlength();
+    int moves = ro.optimize();
+
+    Vehicle opt(nodes);
+    opt.setdepot(nodes[0]);
+    opt.setdumpsite(nodes[1]);
+    opt.setdmatrix(&dm);
+    opt.evaluate();
+    for (int i=1; i<ro.getseq().size()-2; i++)
+        opt.push_back(nodes[ro.getseq()[i]]);
+    checks++;
+    if (ro.getlength() > before or opt.getTWV() > all.getTWV()) wrong++;
+
+    printf( "asymmetric: checks = %d, wrong = %d, routeopt moves = %d\n",
+            checks, wrong, moves );
+}
+
 void Usage() {
-    std::cout << "Usage: tester in.txt\n";
+    std::cout << "Usage: tester in.txt [matrix.mtx]\n";
+}
+
+// what loadproblem() made of the file, as text
+std::string problemAsText(TrashProblem &tp) {
+    std::stringstream ss;
+    std::streambuf *out = std::cout.rdbuf(ss.rdbuf());
+    tp.dumpdataNodes();
+    tp.dumpDepots();
+    tp.dumpDumps();
+    tp.dumpPickups();
+    tp.dumpDmatrix();
+    tp.clarkeWright();
+    std::cout << tp.solutionAsText() << std::endl;
+    std::cout.rdbuf(out);
+    return ss.str();
 }
 
+
 int main(int argc, char **argv) {
 
     if (argc < 2) {
@@ -53,6 +270,12 @@ int main(int argc, char **argv) {
         TestDistanceFromLineSegmentToPoint();
         std::cout << "--------------------------" << std::endl << std::endl;
 
+        std::cout << "Testing Dmatrix ----------"  << std::endl;
+        TestDmatrix();
+        TestMmatrix();
+        TestAsymmetric();
+        std::cout << "--------------------------" << std::endl << std::endl;
+
         Node n;
         std::cout << "Empty Node validity: " << n.isvalid() << std::endl;
         n.set(1, 10, 20);
@@ -123,8 +346,63 @@ int main(int argc, char **argv) {
 
         TrashProblem tp;
 
+        // road network travel times instead of euclidean distances
+        Mmatrix times;
+        if (argc > 2) {
+            times.open(argv[2]);
+            tp.setDistances(&times);
+        }
+
         tp.loadproblem( infile );
 
+        // a load from the cache has to give what parsing the file gives,
+        // for each layout the cache can hold
+        if (argc < 3) {
+            std::cout << "\n----------- cache ---------------------------------\n";
+            std::string cachefile = infile + ".cache";
+            Dmatrix::Layout layouts[2] = { Dmatrix::FULL, Dmatrix::PACKED };
+            for (int l=0; l<2; l++) {
+                std::remove(cachefile.c_str());
+                std::string text[2];
+                Dmatrix::Layout layout[2];
+                // the first load writes the cache, the second maps it
+                for (int pass=0; pass<2; pass++) {
+                    TrashProblem tc;
+                    tc.setMatrixStorage(layouts[l], Dmatrix::FLOAT);
+                    tc.setCache(true);
+                    tc.loadproblem(infile);
+                    text[pass] = problemAsText(tc);
+                    layout[pass] = tc.getMatrixLayout();
+                }
+                std::cout << "cache: layout: " << layouts[l]
+                          << ", cached layout: " << layout[1]
+                          << ", " << (text[0] == text[1] ? "same" : "DIFFERENT")
+                          << std::endl;
+            }
+            std::remove(cachefile.c_str());
+
+            // a cache with a changed byte must not be used
+            std::vector<int> data(100, 7);
+            {
+                Cachewriter w(cachefile, 99, 1, 42);
+                w.add(1, data);
+                w.commit();
+            }
+            Cachefile cf;
+            bool intact = cf.open(cachefile, 99, 1, 42);
+            cf.close();
+            std::fstream f(cachefile.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(sizeof(Cachefile::Header) + 8);
+            f.put(8);
+            f.close();
+            bool damaged = cf.open(cachefile, 99, 1, 42);
+            std::cout << "cache: intact opens: " << (intact ? "yes" : "no")
+                      << ", damaged opens: " << (damaged ? "yes" : "no")
+                      << std::endl;
+            cf.close();
+            std::remove(cachefile.c_str());
+        }
+
         tp.dumpdataNodes();
         //tp.dumpDmatrix();
         tp.dump();
@@ -142,10 +420,84 @@ int main(int argc, char **argv) {
         tp.nearestNeighbor();
         tp.dumpFleet();
 
+        std::cout << "\n----------- nearestInsertion ----------------------\n";
+        tp.nearestInsertion();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- farthestInsertion ---------------------\n";
+        tp.farthestInsertion();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- clarkeWright --------------------------\n";
+        tp.clarkeWright();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- segmentInsertion ----------------------\n";
+        tp.segmentInsertion();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- giantTour -----------------------------\n";
+        tp.giantTour();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- clusterFirst --------------------------\n";
+        tp.clusterFirst();
+        tp.dumpFleet();
+
         std::cout << "\n----------- assignmentSweep -----------------------\n";
         tp.assignmentSweep();
         tp.dumpFleet();
 
+        std::cout << "\n----------- opt_2opt ------------------------------\n";
+        tp.opt_2opt();
+        tp.dumpFleet();
+
+        std::cout << "\n----------- opt_interRoute ------------------------\n";
+        tp.opt_interRoute();
+        tp.opt_2opt();
+        tp.dumpFleet();
+        std::string last = tp.solutionAsText();
+
+        // a new bin and one taken away, the times of a matrix file do not
+        // cover a new node
+        if (argc < 3) {
+            std::cout << "\n----------- addNode/retireNode --------------------\n";
+            tp.clearFleet();
+            int nid = tp.addNode(Trashnode(0, 10, 10, 50, 360, 900, 15, 2));
+            std::cout << "addNode: nid: " << nid << std::endl;
+            tp.retireNode(nid - 1);
+            tp.clusterFirst();
+            tp.dumpFleet();
+
+            // yesterday's routes with the new bin and without the old one
+            std::cout << "\n----------- warmStart -----------------------------\n";
+            tp.warmStart(last);
+            tp.opt_2opt();
+            tp.dumpFleet();
+
+            // the pickups that were kept have to be back on their depot
+            std::map<int, int> was;
+            std::stringstream ss(last);
+            std::string item;
+            int depot = -1;
+            while (std::getline(ss, item, ',')) {
+                int n = atoi(item.c_str());
+                if (n == -1) depot = -1;
+                else if (depot == -1) depot = n;
+                else was[n] = depot;
+            }
+            std::vector<int> now = tp.solutionAsVector();
+            int same = 0, moved = 0;
+            depot = -1;
+            for (int i=0; i<now.size(); i++) {
+                if (now[i] == -1) depot = -1;
+                else if (depot == -1) depot = now[i];
+                else if (was.count(now[i]))
+                    (was[now[i]] == depot ? same : moved)++;
+            }
+            std::cout << "warmStart: on their depot: " << same
+                      << ", moved: " << moved << std::endl;
+        }
 
     }
     catch (const std::exception &e) {
@@ -1,6 +1,5 @@
 
 #include <iostream>
-#include <sstream>
 
 #include "trashnode.h"
 
@@ -70,15 +69,26 @@ void Trashnode::setdumpdist(int _nid, double _dist) {
 
 
 Trashnode::Trashnode(std::string line) {
-    std::istringstream buffer( line );
-    buffer >> nid;
-    buffer >> ntype;
-    buffer >> x;
-    buffer >> y;
-    buffer >> demand;
-    buffer >> tw_open;
-    buffer >> tw_close;
-    buffer >> service;
+    Tokenizer tk(line.data(), line.size());
+    tk.nextline();
+    read(tk);
+}
+
+
+// read the values of the current line of tk
+Trashnode::Trashnode(Tokenizer &tk) {
+    read(tk);
+}
+
+
+void Trashnode::read(Tokenizer &tk) {
+    tk >> nid >> ntype >> x >> y >> demand >> tw_open >> tw_close >> service;
+    depotdist = 0.0;
+    depotnid = -1;
+    depotdist2 = 0.0;
+    depotnid2 = -1;
+    dumpdist = 0.0;
+    dumpnid = -1;
 }
 
 
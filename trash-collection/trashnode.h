@@ -13,9 +13,11 @@ class Trashnode : public Twnode {
     double dumpdist;        // distance to nearest dump
     long int dumpnid;       // nid of closet dump
 
+    void read(Tokenizer &tk);
 
   public:
     // accessors
+    int getntype() const {return ntype;};
     double getdepotdist() const {return depotdist;};
     long int getdepotnid() const {return depotnid;};
     double getdepotdist2() const {return depotdist2;};
@@ -62,7 +64,9 @@ class Trashnode : public Twnode {
         dumpnid = -1;
     };
 
+    // nid ntype x y demand tw_open tw_close service
     Trashnode(std::string line);
+    Trashnode(Tokenizer &tk);
 
     ~Trashnode() {};
 
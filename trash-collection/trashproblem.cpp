@@ -1,33 +1,47 @@
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
 #include <limits>
+#include <queue>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
+#include "tokenizer.h"
 #include "vec2d.h"
+#include "interroute.h"
 #include "trashproblem.h"
 
 double TrashProblem::distance(int n1, int n2) const {
-    return datanodes[n1].distance(datanodes[n2]);
+    return dMatrix.get(n1, n2);
 }
 
 
 void TrashProblem::loadproblem(std::string& file) {
-    std::ifstream in( file.c_str() );
-    std::string line;
+    // the cache only holds what is derived from the euclidean distances
+    bool cached = usecache and !provider;
+    uint64_t key = 0;
+    if (cached) {
+        key = cacheKey(file);
+        if (loadCache(file + ".cache", key)) {
+            buildNodesets();
+            return;
+        }
+    }
 
-    // read the nodes
-    int cnt = 0;
-    while ( std::getline(in, line) ) {
-        cnt++;
-        // skip comment lines
-        if (line[0] == '#') continue;
+    Tokenizer tk(file);
 
-        Trashnode node( line );
+    // read the nodes
+    while ( tk.nextline() ) {
+        Trashnode node( tk );
         if (!node.isvalid())
-            std::cout << "ERROR: line: " << cnt << ": " << line << std::endl;
+            std::cout << "ERROR: line: " << tk.line() << std::endl;
 
         datanodes.push_back(node);
 
@@ -39,12 +53,274 @@ void TrashProblem::loadproblem(std::string& file) {
             dumps.push_back(node.getnid());
     }
 
-    in.close();
-
     buildDistanceMatrix();
+    prefetchFacilities();
 
     for (int i=0; i<datanodes.size(); i++)
         setNodeDistances(datanodes[i]);
+
+    buildNodesets();
+
+    // a cache we can not write only costs the next load some time
+    if (cached) {
+        try {
+            saveCache(file + ".cache", key);
+        }
+        catch (const std::exception &e) {
+            std::cout << "WARNING: " << e.what() << std::endl;
+        }
+    }
+}
+
+
+// keep the facility rows around, they are used over and over
+void TrashProblem::prefetchFacilities() {
+    for (int i=0; i<depots.size(); i++)
+        dMatrix.prefetch(depots[i]);
+    for (int i=0; i<dumps.size(); i++)
+        dMatrix.prefetch(dumps[i]);
+}
+
+
+// sections of the cache, the nodes are kept as one array per attribute
+enum CacheSection {
+    CACHE_NID = 1, CACHE_NTYPE, CACHE_X, CACHE_Y, CACHE_DEMAND,
+    CACHE_OPEN, CACHE_CLOSE, CACHE_SERVICE,
+    CACHE_DEPOTNID, CACHE_DEPOTDIST, CACHE_DEPOTNID2, CACHE_DEPOTDIST2,
+    CACHE_DUMPNID, CACHE_DUMPDIST,
+    CACHE_MATRIX,               // a FULL dMatrix as an Mmatrix
+    CACHE_PACKED,               // the cells of a PACKED dMatrix
+    CACHE_SCALE                 // and the scale they were made with
+};
+
+const uint32_t CACHE_KIND = 0x48535254;     // "TRSH"
+const uint32_t CACHE_VERSION = 2;           // bump when the sections change
+
+
+// the source file and the matrix storage, a cache made with another
+// storage does not match
+uint64_t TrashProblem::cacheKey(const std::string &file) const {
+    int storage[2] = { dMatrix.getlayout(), dMatrix.getprecision() };
+    double scale = dMatrix.getscale();
+    uint64_t key = Cachefile::hash(file);
+    key = Cachefile::hash(key, storage, sizeof(storage));
+    return Cachefile::hash(key, &scale, sizeof(scale));
+}
+
+
+// Load the nodes with their nearest depots and dump, and the distance
+// matrix, from a cache made by saveCache() with the same key. The matrix
+// keeps the layout it was made with: a FULL matrix is used in place from
+// the mapped file and the triangle of a PACKED one is copied out of it.
+// ONDEMAND matrices are not cached and are built again from the
+// coordinates. Returns false if the cache is missing or stale.
+bool TrashProblem::loadCache(const std::string &file, uint64_t key) {
+    if (!cache.open(file, CACHE_KIND, CACHE_VERSION, key))
+        return false;
+
+    size_t bytes = 0;
+    cache.section(CACHE_NID, &bytes);
+    int n = bytes / sizeof(int);
+
+    const int *nid = cache.array<int>(CACHE_NID, n);
+    const int *ntype = cache.array<int>(CACHE_NTYPE, n);
+    const double *x = cache.array<double>(CACHE_X, n);
+    const double *y = cache.array<double>(CACHE_Y, n);
+    const int *demand = cache.array<int>(CACHE_DEMAND, n);
+    const int *twopen = cache.array<int>(CACHE_OPEN, n);
+    const int *twclose = cache.array<int>(CACHE_CLOSE, n);
+    const int *service = cache.array<int>(CACHE_SERVICE, n);
+    const int *depotnid = cache.array<int>(CACHE_DEPOTNID, n);
+    const double *depotdist = cache.array<double>(CACHE_DEPOTDIST, n);
+    const int *depotnid2 = cache.array<int>(CACHE_DEPOTNID2, n);
+    const double *depotdist2 = cache.array<double>(CACHE_DEPOTDIST2, n);
+    const int *dumpnid = cache.array<int>(CACHE_DUMPNID, n);
+    const double *dumpdist = cache.array<double>(CACHE_DUMPDIST, n);
+
+    if (!n or !nid or !ntype or !x or !y or !demand or !twopen or !twclose
+            or !service or !depotnid or !depotdist or !depotnid2
+            or !depotdist2 or !dumpnid or !dumpdist) {
+        cache.close();
+        return false;
+    }
+
+    const void *m = cache.section(CACHE_MATRIX, &bytes);
+    if (m) {
+        try {
+            cachedmatrix.view(m, bytes);
+        }
+        catch (const std::exception &e) {
+            cache.close();
+            return false;
+        }
+        if (cachedmatrix.size() != n) {
+            cachedmatrix.close();
+            cache.close();
+            return false;
+        }
+    }
+
+    size_t cellbytes = 0;
+    const void *cells = cache.section(CACHE_PACKED, &cellbytes);
+    const double *scale = cache.array<double>(CACHE_SCALE, 1);
+    bool packed = cells and scale;
+    if (packed) {
+        try {
+            dMatrix.readcells(n, *scale, cells, cellbytes);
+        }
+        catch (const std::exception &e) {
+            cache.close();
+            return false;
+        }
+    }
+
+    datanodes.reserve(n);
+    for (int i=0; i<n; i++) {
+        Trashnode node(nid[i], x[i], y[i], demand[i], twopen[i], twclose[i],
+                       service[i], ntype[i]);
+        node.setdepotdist(depotnid[i], depotdist[i], depotnid2[i], depotdist2[i]);
+        node.setdumpdist(dumpnid[i], dumpdist[i]);
+        datanodes.push_back(node);
+
+        if (node.ispickup())
+            pickups.push_back(node.getnid());
+        else if (node.isdepot())
+            depots.push_back(node.getnid());
+        else if (node.isdump())
+            dumps.push_back(node.getnid());
+    }
+
+    if (m) {
+        dMatrix.attach(cachedmatrix);
+    }
+    else if (!packed) {
+        buildDistanceMatrix();
+        prefetchFacilities();
+    }
+    return true;
+}
+
+
+void TrashProblem::saveCache(const std::string &file, uint64_t key) const {
+    int n = datanodes.size();
+    std::vector<int> nid(n), ntype(n), demand(n), twopen(n), twclose(n);
+    std::vector<int> service(n), depotnid(n), depotnid2(n), dumpnid(n);
+    std::vector<double> x(n), y(n), depotdist(n), depotdist2(n), dumpdist(n);
+
+    for (int i=0; i<n; i++) {
+        const Trashnode &tn(datanodes[i]);
+        nid[i] = tn.getnid();
+        ntype[i] = tn.getntype();
+        x[i] = tn.getx();
+        y[i] = tn.gety();
+        demand[i] = tn.getdemand();
+        twopen[i] = tn.opens();
+        twclose[i] = tn.closes();
+        service[i] = tn.getservicetime();
+        depotnid[i] = tn.getdepotnid();
+        depotdist[i] = tn.getdepotdist();
+        depotnid2[i] = tn.getdepotnid2();
+        depotdist2[i] = tn.getdepotdist2();
+        dumpnid[i] = tn.getdumpnid();
+        dumpdist[i] = tn.getdumpdist();
+    }
+
+    Cachewriter w(file, CACHE_KIND, CACHE_VERSION, key);
+    w.add(CACHE_NID, nid);
+    w.add(CACHE_NTYPE, ntype);
+    w.add(CACHE_X, x);
+    w.add(CACHE_Y, y);
+    w.add(CACHE_DEMAND, demand);
+    w.add(CACHE_OPEN, twopen);
+    w.add(CACHE_CLOSE, twclose);
+    w.add(CACHE_SERVICE, service);
+    w.add(CACHE_DEPOTNID, depotnid);
+    w.add(CACHE_DEPOTDIST, depotdist);
+    w.add(CACHE_DEPOTNID2, depotnid2);
+    w.add(CACHE_DEPOTDIST2, depotdist2);
+    w.add(CACHE_DUMPNID, dumpnid);
+    w.add(CACHE_DUMPDIST, dumpdist);
+
+    if (dMatrix.getlayout() == Dmatrix::PACKED and !dMatrix.isattached()) {
+        dMatrix.writecells(w.begin(CACHE_PACKED));
+        w.add(CACHE_SCALE, std::vector<double>(1, dMatrix.getscale()));
+    }
+    else if (dMatrix.getlayout() != Dmatrix::ONDEMAND) {
+        Mmatrix::Dtype dtype;
+        switch (dMatrix.getprecision()) {
+            case Dmatrix::DOUBLE: dtype = Mmatrix::DOUBLE; break;
+            case Dmatrix::FLOAT:  dtype = Mmatrix::FLOAT;  break;
+            default:              dtype = Mmatrix::SCALED; break;
+        }
+        Mmatrix::write(w.begin(CACHE_MATRIX), dMatrix, dtype, dMatrix.getscale());
+    }
+
+    w.commit();
+}
+
+
+// needs the depotnid and depotnid2 set by setNodeDistances()
+void TrashProblem::buildNodesets() {
+    int n = datanodes.size();
+
+    pickupset.resize(n);
+    depotset.resize(n);
+    dumpset.resize(n);
+    unassigned.resize(n);
+    unassigned.fill();
+    clusters.clear();
+
+    for (int i=0; i<n; i++) {
+        const Trashnode &tn(datanodes[i]);
+        if (tn.ispickup()) pickupset.set(i);
+        if (tn.isdepot()) depotset.set(i);
+        if (tn.isdump()) dumpset.set(i);
+        addToClusters(i);
+    }
+}
+
+
+// make room in the node sets for n nodes
+void TrashProblem::growNodesets(int n) {
+    pickupset.grow(n);
+    depotset.grow(n);
+    dumpset.grow(n);
+    unassigned.grow(n);
+    std::map<long int, Nodeset>::iterator it;
+    for (it=clusters.begin(); it!=clusters.end(); it++)
+        it->second.grow(n);
+}
+
+
+void TrashProblem::addToClusters(int nid) {
+    const Trashnode &tn(datanodes[nid]);
+
+    Nodeset &c1 = clusters[tn.getdepotnid()];
+    if (!c1.size()) c1.resize(datanodes.size());
+    c1.set(nid);
+
+    Nodeset &c2 = clusters[tn.getdepotnid2()];
+    if (!c2.size()) c2.resize(datanodes.size());
+    c2.set(nid);
+}
+
+
+void TrashProblem::removeFromClusters(int nid) {
+    const Trashnode &tn(datanodes[nid]);
+    std::map<long int, Nodeset>::iterator it;
+
+    it = clusters.find(tn.getdepotnid());
+    if (it != clusters.end()) it->second.reset(nid);
+    it = clusters.find(tn.getdepotnid2());
+    if (it != clusters.end()) it->second.reset(nid);
+}
+
+
+// work out the nearest depots and dump of nid again
+void TrashProblem::reassign(int nid) {
+    removeFromClusters(nid);
+    setNodeDistances(datanodes[nid]);
+    addToClusters(nid);
 }
 
 
@@ -57,7 +333,7 @@ void TrashProblem::setNodeDistances(Trashnode& n) {
     if (n.isdepot()) {
         n.setdepotdist(n.getnid(), 0.0, -1, -1.0);
         for (int i=0; i<dumps.size(); i++) {
-            double d = dMatrix[n.getnid()][dumps[i]];
+            double d = dMatrix.get(n.getnid(), dumps[i]);
             if (nid == -1 or d < dist) {
                 dist = d;
                 nid = dumps[i];
@@ -68,7 +344,7 @@ void TrashProblem::setNodeDistances(Trashnode& n) {
     else if (n.isdump()) {
         n.setdumpdist(n.getnid(), 0.0);
         for (int i=0; i<depots.size(); i++) {
-            double d = dMatrix[n.getnid()][depots[i]];
+            double d = dMatrix.get(n.getnid(), depots[i]);
             if (nid == -1 or d < dist) {
                 dist = d;
                 nid = depots[i];
@@ -78,7 +354,7 @@ void TrashProblem::setNodeDistances(Trashnode& n) {
     }
     else if (n.ispickup()) {
         for (int i=0; i<dumps.size(); i++) {
-            double d = dMatrix[n.getnid()][dumps[i]];
+            double d = dMatrix.get(n.getnid(), dumps[i]);
             if (nid == -1 or d < dist) {
                 dist = d;
                 nid = dumps[i];
@@ -86,29 +362,201 @@ void TrashProblem::setNodeDistances(Trashnode& n) {
         }
         n.setdumpdist(nid, dist);
 
+        // keep the nearest and the second nearest depot
         nid = -1;
         for (int i=0; i<depots.size(); i++) {
-            double d = dMatrix[n.getnid()][depots[i]];
+            double d = dMatrix.get(n.getnid(), depots[i]);
             if (nid == -1 or d < dist) {
                 dist2 = dist;
                 nid2 = nid;
                 dist = d;
                 nid = depots[i];
             }
+            else if (nid2 == -1 or d < dist2) {
+                dist2 = d;
+                nid2 = depots[i];
+            }
         }
+        if (nid2 == -1)
+            dist2 = -1.0;
         n.setdepotdist(nid, dist, nid2, dist2);
     }
 }
 
 
 void TrashProblem::buildDistanceMatrix() {
-    dMatrix.clear();
-    dMatrix.resize(datanodes.size());
+    if (provider) {
+        if (provider->size() != datanodes.size()) {
+            std::string errmsg = "TrashProblem::buildDistanceMatrix - the distance provider does not match the number of nodes.";
+            throw std::runtime_error(errmsg);
+        }
+        const Mmatrix *m = dynamic_cast<const Mmatrix *>(provider);
+        if (m)
+            dMatrix.attach(*m);
+        else
+            dMatrix.load(*provider);
+        return;
+    }
+
+    std::vector<double> x(datanodes.size());
+    std::vector<double> y(datanodes.size());
     for (int i=0; i<datanodes.size(); i++) {
-        dMatrix[i].clear();
-        dMatrix[i].resize(datanodes.size());
-        for (int j=0; j<datanodes.size(); j++) {
-            dMatrix[i][j] = datanodes[i].distance(datanodes[j]);
+        x[i] = datanodes[i].getx();
+        y[i] = datanodes[i].gety();
+    }
+    dMatrix.build(x, y);
+}
+
+
+// Add a node after loadproblem(). It takes the nid of a retired node if
+// there is one, otherwise it becomes the last node. Its distances are
+// computed from the coordinates, or taken from to and from when the
+// distances came from a provider: to[j] is the travel time from the node
+// to node j and from[j] the time from node j to it, for every j up to the
+// number of nodes with the new one.
+//
+// Only the nodes the new one can change are looked at again: a new depot
+// can only be the nearest depot of nodes that are closer to it than to
+// their current ones, likewise for a new dump. Returns the nid.
+int TrashProblem::addNode(const Trashnode &node, const double *to,
+                          const double *from) {
+    if (!node.isdepot() and !node.isdump() and !node.ispickup()) {
+        std::string errmsg = "TrashProblem::addNode - the node has no type.";
+        throw std::runtime_error(errmsg);
+    }
+    if ((provider or to or from) and (!to or !from)) {
+        std::string errmsg = "TrashProblem::addNode - the travel times to and from the node are needed.";
+        throw std::runtime_error(errmsg);
+    }
+
+    int nid;
+    if (retired.size()) {
+        nid = retired.back();
+        retired.pop_back();
+        datanodes[nid] = node;
+    }
+    else {
+        nid = datanodes.size();
+        datanodes.push_back(node);
+    }
+    int n = datanodes.size();
+    Trashnode &tn(datanodes[nid]);
+    tn.setnid(nid);
+
+    if (to and from)
+        dMatrix.setrow(nid, to, from);
+    else {
+        std::vector<double> x(n), y(n), d(n);
+        for (int i=0; i<n; i++) {
+            x[i] = datanodes[i].getx();
+            y[i] = datanodes[i].gety();
+        }
+        Dmatrix::distances(tn.getx(), tn.gety(), &x[0], &y[0], n, &d[0]);
+        dMatrix.setrow(nid, &d[0], &d[0], tn.getx(), tn.gety());
+    }
+
+    growNodesets(n);
+    unassigned.set(nid);
+
+    if (tn.ispickup()) {
+        pickups.push_back(nid);
+        pickupset.set(nid);
+        setNodeDistances(tn);
+        addToClusters(nid);
+        updateNeighbors(nid);
+    }
+    else if (tn.isdepot()) {
+        depots.push_back(nid);
+        depotset.set(nid);
+        setNodeDistances(tn);
+        addToClusters(nid);
+
+        for (int i=0; i<dumps.size(); i++) {
+            const Trashnode &du(datanodes[dumps[i]]);
+            if (du.getdepotnid() == -1
+                    or dMatrix.get(du.getnid(), nid) < du.getdepotdist())
+                reassign(dumps[i]);
+        }
+        for (int i=0; i<pickups.size(); i++) {
+            const Trashnode &pu(datanodes[pickups[i]]);
+            if (pu.getdepotnid2() == -1
+                    or dMatrix.get(pu.getnid(), nid) < pu.getdepotdist2())
+                reassign(pickups[i]);
+        }
+    }
+    else {
+        dumps.push_back(nid);
+        dumpset.set(nid);
+        setNodeDistances(tn);
+        addToClusters(nid);
+
+        // the dump does not change the clusters
+        for (int k=0; k<2; k++) {
+            const std::vector<int> &nids(k ? pickups : depots);
+            for (int i=0; i<nids.size(); i++) {
+                Trashnode &m(datanodes[nids[i]]);
+                double d = dMatrix.get(m.getnid(), nid);
+                if (m.getdumpnid() == -1 or d < m.getdumpdist())
+                    m.setdumpdist(nid, d);
+            }
+        }
+    }
+
+    return nid;
+}
+
+
+// Take a node out of the problem, like a bin that was removed or a dump
+// that closed. The nid is kept, with no type, until addNode() reuses it,
+// so the routes and the matrix keep their numbering. The nodes that had
+// it as their nearest depot or dump get new ones.
+void TrashProblem::retireNode(int nid) {
+    if (nid < 0 or nid >= datanodes.size() or datanodes[nid].getntype() < 0) {
+        std::string errmsg = "TrashProblem::retireNode - no such node.";
+        throw std::runtime_error(errmsg);
+    }
+    for (int i=0; i<fleet.size(); i++) {
+        const Vehicle &v(fleet[i]);
+        if (v.getdepot().getnid() == nid or v.getdumpsite().getnid() == nid
+                or std::find(v.begin(), v.end(), nid) != v.end()) {
+            std::string errmsg = "TrashProblem::retireNode - the node is on a route.";
+            throw std::runtime_error(errmsg);
+        }
+    }
+
+    Trashnode &tn(datanodes[nid]);
+    int ntype = tn.getntype();
+    removeFromClusters(nid);
+    tn.setntype(-1);
+    unassigned.reset(nid);
+    retired.push_back(nid);
+
+    if (ntype == 2) {
+        pickups.erase(std::find(pickups.begin(), pickups.end(), nid));
+        pickupset.reset(nid);
+        updateNeighbors(nid);
+    }
+    else if (ntype == 0) {
+        depots.erase(std::find(depots.begin(), depots.end(), nid));
+        depotset.reset(nid);
+        for (int k=0; k<2; k++) {
+            const std::vector<int> &nids(k ? pickups : dumps);
+            for (int i=0; i<nids.size(); i++) {
+                const Trashnode &m(datanodes[nids[i]]);
+                if (m.getdepotnid() == nid or m.getdepotnid2() == nid)
+                    reassign(nids[i]);
+            }
+        }
+        clusters.erase(nid);
+    }
+    else {
+        dumps.erase(std::find(dumps.begin(), dumps.end(), nid));
+        dumpset.reset(nid);
+        for (int k=0; k<2; k++) {
+            const std::vector<int> &nids(k ? pickups : depots);
+            for (int i=0; i<nids.size(); i++)
+                if (datanodes[nids[i]].getdumpnid() == nid)
+                    reassign(nids[i]);
         }
     }
 }
@@ -124,117 +572,282 @@ void TrashProblem::buildDistanceMatrix() {
 //          16 - must be pickup nodes       PICKUP
 //          32 - must be depot nodes        DEPOT
 //          64 - must be dump nodes         DUMP
+//
+// The scans below are templates on the selector. S is either one of the
+// masks in the scans table, in which case every test of a selector bit is
+// decided by the compiler, or SCAN_ANY to test the selector passed in at
+// run time. findNearestNodeTo() looks the selector up in the table.
+
+const int SCAN_ANY = -1;
+
+const TrashProblem::Scans TrashProblem::scans[] = {
+    { UNASSIGNED|PICKUP|LIMITDEMAND,
+      &TrashProblem::scanNodes<UNASSIGNED|PICKUP|LIMITDEMAND>,
+      &TrashProblem::scanPath<UNASSIGNED|PICKUP|LIMITDEMAND> },
+    { UNASSIGNED|PICKUP|CLUSTER1|CLUSTER2|LIMITDEMAND,
+      &TrashProblem::scanNodes<UNASSIGNED|PICKUP|CLUSTER1|CLUSTER2|LIMITDEMAND>,
+      &TrashProblem::scanPath<UNASSIGNED|PICKUP|CLUSTER1|CLUSTER2|LIMITDEMAND> },
+    { UNASSIGNED|PICKUP|CLUSTER1,
+      &TrashProblem::scanNodes<UNASSIGNED|PICKUP|CLUSTER1>,
+      &TrashProblem::scanPath<UNASSIGNED|PICKUP|CLUSTER1> },
+    // must be last, used for any other selector
+    { SCAN_ANY,
+      &TrashProblem::scanNodes<SCAN_ANY>,
+      &TrashProblem::scanPath<SCAN_ANY> }
+};
+
+
+const TrashProblem::Scans& TrashProblem::findScans(int selector) {
+    int i = 0;
+    while (scans[i].selector != SCAN_ANY and scans[i].selector != selector)
+        i++;
+    return scans[i];
+}
 
-bool TrashProblem::filterNode(const Trashnode &tn, int i, int selector, int demandLimit) {
-        bool select = false;
-
-        // filter out nodes where the demand > demandLimit
-        if (selector & LIMITDEMAND and datanodes[i].getdemand() > demandLimit)
-            return true;
-
-        // if select any
-        if (!selector)
-            select = true;
-        // is pickup node
-        else if (selector & PICKUP and datanodes[i].ispickup())
-            select = true;
-        // is depot node
-        else if (selector & DEPOT and datanodes[i].isdepot())
-            select = true;
-        // is dump node
-        else if (selector & DUMP and datanodes[i].isdump())
-            select = true;
+
+template <int S>
+bool TrashProblem::keepNode(const Trashnode &tn, int i, int selector, int demandLimit) const {
+    const int sel = S == SCAN_ANY ? selector : S;
+    const Trashnode &n(datanodes[i]);
+
+    // filter out nodes where the demand > demandLimit
+    if (sel & LIMITDEMAND and n.getdemand() > demandLimit)
+        return false;
+
+    // is unassigned node
+    if (sel & UNASSIGNED and ! unassigned.test(i))
+        return false;
+
+    // select any
+    if (!(sel & ~(LIMITDEMAND|UNASSIGNED)))
+        return !sel;
+
+    return (sel & PICKUP and pickupset.test(i))
+        or (sel & DEPOT and depotset.test(i))
+        or (sel & DUMP and dumpset.test(i))
         // belongs to cluster1
-        else if (selector & CLUSTER1 and (
-                 tn.getdepotnid() == datanodes[i].getdepotnid() or
-                 tn.getdepotnid() == datanodes[i].getdepotnid2() ) )
-                select = true;
+        or (sel & CLUSTER1 and (
+               tn.getdepotnid() == n.getdepotnid() or
+               tn.getdepotnid() == n.getdepotnid2() ) )
         // belongs to cluster2
-        else if (selector & CLUSTER2 and (
-                 tn.getdepotnid2() == datanodes[i].getdepotnid() or
-                 tn.getdepotnid2() == datanodes[i].getdepotnid2() ) )
-                select = true;
+        or (sel & CLUSTER2 and (
+               tn.getdepotnid2() == n.getdepotnid() or
+               tn.getdepotnid2() == n.getdepotnid2() ) );
+}
+
+
+bool TrashProblem::filterNode(const Trashnode &tn, int i, int selector, int demandLimit) {
+    return ! keepNode<SCAN_ANY>(tn, i, selector, demandLimit);
+}
 
-        // is unassigned node
-        if (selector & UNASSIGNED and ! unassigned[i])
-            return true;
 
-        if (!select)
-            return true;
+// the nodes filterNode() would keep, except for LIMITDEMAND which depends
+// on the query and has to be checked on each node taken from sel
+void TrashProblem::selectNodes(const Trashnode &tn, int selector, Nodeset &sel) const {
+    if (sel.size() != datanodes.size())
+        sel.resize(datanodes.size());
 
-        return ! select;
+    if (!(selector & ~LIMITDEMAND & ~UNASSIGNED)) {
+        if (selector) sel.clear();
+        else sel.fill();
+        return;
+    }
+
+    sel.clear();
+    if (selector & PICKUP) sel |= pickupset;
+    if (selector & DEPOT) sel |= depotset;
+    if (selector & DUMP) sel |= dumpset;
+    if (selector & CLUSTER1) addCluster(sel, tn.getdepotnid());
+    if (selector & CLUSTER2) addCluster(sel, tn.getdepotnid2());
+
+    if (selector & UNASSIGNED) sel &= unassigned;
+}
+
+
+const Nodeset* TrashProblem::findCluster(long int depotnid) const {
+    std::map<long int, Nodeset>::const_iterator it = clusters.find(depotnid);
+    return it == clusters.end() ? NULL : &it->second;
+}
+
+
+void TrashProblem::addCluster(Nodeset &sel, long int depotnid) const {
+    const Nodeset *c = findCluster(depotnid);
+    if (c) sel |= *c;
+}
+
+
+// nearest node to tn, the candidates of each word of nodes are worked out
+// from the node sets and only their bits are visited
+template <int S>
+int TrashProblem::scanNodes(const Trashnode &tn, int selector, int demandLimit, double *dist) {
+    const int sel = S == SCAN_ANY ? selector : S;
+    const Nodeset *c1 = sel & CLUSTER1 ? findCluster(tn.getdepotnid()) : NULL;
+    const Nodeset *c2 = sel & CLUSTER2 ? findCluster(tn.getdepotnid2()) : NULL;
+    int nn = -1;
+
+    for (int w=0; w<pickupset.words(); w++) {
+        uint64_t m = 0;
+
+        if (!(sel & ~(LIMITDEMAND|UNASSIGNED))) {
+            if (!sel) m = pickupset.mask(w);
+        }
+        else {
+            if (sel & PICKUP) m |= pickupset.word(w);
+            if (sel & DEPOT) m |= depotset.word(w);
+            if (sel & DUMP) m |= dumpset.word(w);
+            if (sel & CLUSTER1 and c1) m |= c1->word(w);
+            if (sel & CLUSTER2 and c2) m |= c2->word(w);
+            if (sel & UNASSIGNED) m &= unassigned.word(w);
+        }
+
+        while (m) {
+            int i = w * 64 + __builtin_ctzll(m);
+            m &= m - 1;
+
+            if (sel & LIMITDEMAND and datanodes[i].getdemand() > demandLimit)
+                continue;
+
+            double d = dMatrix.get(tn.getnid(), i);
+            if (nn == -1 or d < *dist) {
+                *dist = d;
+                nn = i;
+            }
+        }
+    }
+
+    return nn;
 }
 
 
 int TrashProblem::findNearestNodeTo(int nid, int selector, int demandLimit) {
     Trashnode &tn(datanodes[nid]);
-    int nn = -1;    // init to not found
     double dist = -1;    // dist to nn
 
-    for (int i=0; i<datanodes.size(); i++) {
+    // we are about to scan the whole row
+    dMatrix.prefetch(tn.getnid());
 
-        if (filterNode(tn, i, selector, demandLimit)) continue;
+    int nn = (this->*findScans(selector).nodes)(tn, selector, demandLimit, &dist);
 
-        double d = dMatrix[tn.getnid()][i];
-        if (nn == -1 or d < dist) {
-            dist = d;
-            nn = i;
-        }
-    }
     std::cout << "TrashProblem::findNearestNodeTo(" << nid << ", " << selector << ") = " << nn << " at dist = " << dist << std::endl;
     return nn;
 }
 
 
-int TrashProblem::findNearestNodeTo(Vehicle &v, int selector, int demandLimit, int *pos) {
-    Trashnode depot(v.getdepot());
-    Trashnode dump(v.getdumpsite());
+// functor used by SegmentIndex to apply keepNode to its candidates
+template <int S>
+class NodeFilter {
+  private:
+    const TrashProblem &tp;
+    const Trashnode &tn;
+    int selector;
+    int demandLimit;
+
+  public:
+    NodeFilter(const TrashProblem &_tp, const Trashnode &_tn, int _selector,
+               int _demandLimit)
+        : tp(_tp), tn(_tn), selector(_selector), demandLimit(_demandLimit) {};
+
+    // true if nid should be skipped
+    bool operator()(int nid) {
+        return ! tp.keepNode<S>(tn, nid, selector, demandLimit);
+    };
+};
+
+
+// nearest node to the segments of the path of v
+template <int S>
+int TrashProblem::scanPath(const Vehicle &v, int selector, int demandLimit, int *pos, double *dist) {
+    const int sel = S == SCAN_ANY ? selector : S;
+    const Trashnode &depot(v.getdepot());
+    const Trashnode &dump(v.getdumpsite());
     int nn = -1;        // init to not found
     int loc = 0;        // position in path to insert
-    double dist = -1;   // dist to nn
     double qx, qy;
 
-    std::cout << "TrashProblem::findNearestNodeTo(V" << depot.getnid() << ", " << selector << ")\n";
+    // the index only holds unassigned pickups so it can only answer
+    // queries that are restricted to those
+    if (sindex.isbuilt()
+            and (sel & (UNASSIGNED|PICKUP)) == (UNASSIGNED|PICKUP)
+            and !(sel & (DEPOT|DUMP))) {
 
-    for (int i=0; i<datanodes.size(); i++) {
+        int limit = (sel & LIMITDEMAND) ? demandLimit : 0;
+        if (!sindex.cachevalid(depot.getnid(), sel, limit, v.size()+1))
+            sindex.resetSegments(depot.getnid(), sel, limit, v.size()+1);
 
-        if (filterNode(depot, i, selector, demandLimit)) {
-            std::cout << "FILTERED: ";
-            datanodes[i].dump();
-            continue;
-        }
+        NodeFilter<S> filter(*this, depot, selector, demandLimit);
+        const Trashnode *last = &depot;
+
+        for (int j=0; j<=v.size(); j++) {
+            const Trashnode &next = (j < v.size()) ? v[j] : dump;
 
-        double d;
-        Trashnode &last = depot;
+            // reuse the cached answer if that node is still a candidate
+            int snid = sindex.getsegnid(j);
+            double d = sindex.getsegdist(j);
+            if (snid == -1 or (snid >= 0 and filter(snid))) {
+                snid = sindex.nearestToSegment(*last, next, filter, &d);
+                sindex.setsegment(j, snid, d);
+            }
 
-        for (int j=0; j<v.size(); j++) {
+            if (snid >= 0 and (nn == -1 or d < *dist)) {
+                *dist = d;
+                loc = j;
+                nn = snid;
+            }
+            last = &next;
+        }
+    }
+    else {
+        selectNodes(depot, sel, candidates);
+
+        for (int i=candidates.first(); i!=-1; i=candidates.next(i)) {
+
+            if (sel & LIMITDEMAND and datanodes[i].getdemand() > demandLimit)
+                continue;
+
+            double d;
+            const Trashnode *last = &depot;
+
+            for (int j=0; j<v.size(); j++) {
+                d = distanceFromLineSegmentToPoint(
+                    last->getx(), last->gety(), v[j].getx(), v[j].gety(),
+                    datanodes[i].getx(), datanodes[i].gety(), &qx, &qy);
+                if (nn == -1 or d < *dist) {
+                    *dist = d;
+                    loc = j;
+                    nn = i;
+                }
+                last = &v[j];
+            }
             d = distanceFromLineSegmentToPoint(
-                last.getx(), last.gety(), v[j].getx(), v[j].gety(),
+                last->getx(), last->gety(), dump.getx(), dump.gety(),
                 datanodes[i].getx(), datanodes[i].gety(), &qx, &qy);
-            if (nn == -1 or d < dist) {
-                dist = d;
-                loc = j;
+            if (nn == -1 or d < *dist) {
+                *dist = d;
+                loc = v.size();
                 nn = i;
             }
-            last = v[j];
-        }
-        d = distanceFromLineSegmentToPoint(
-            last.getx(), last.gety(), dump.getx(), dump.gety(),
-            datanodes[i].getx(), datanodes[i].gety(), &qx, &qy);
-        if (nn == -1 or d < dist) {
-            dist = d;
-            loc = v.size();
-            nn = i;
         }
     }
 
-    std::cout << "TrashProblem::findNearestNodeTo(V" << depot.getnid() << ", " << selector << ") = " << nn << " at dist = " << dist << " at pos = " << loc << std::endl;
-
     *pos = loc;
     return nn;
 }
 
 
+int TrashProblem::findNearestNodeTo(Vehicle &v, int selector, int demandLimit, int *pos) {
+    int depotnid = v.getdepot().getnid();
+    double dist = -1;   // dist to nn
+
+    std::cout << "TrashProblem::findNearestNodeTo(V" << depotnid << ", " << selector << ")\n";
+
+    int nn = (this->*findScans(selector).path)(v, selector, demandLimit, pos, &dist);
+
+    std::cout << "TrashProblem::findNearestNodeTo(V" << depotnid << ", " << selector << ") = " << nn << " at dist = " << dist << " at pos = " << *pos << std::endl;
+
+    return nn;
+}
+
+
 std::string TrashProblem::solutionAsText() {
     std::stringstream ss;;
     std::vector<int> s = solutionAsVector();
@@ -246,10 +859,12 @@ std::string TrashProblem::solutionAsText() {
 }
 
 
+// each route is its depot, its pickups and -1
 std::vector<int>  TrashProblem::solutionAsVector() {
     std::vector<int> s;
     for (int i=0; i<fleet.size(); i++) {
         if (fleet[i].size() == 0) continue;
+        s.push_back(fleet[i].getdepot().getnid());
         for (int j=0; j<fleet[i].size(); j++) {
             s.push_back(fleet[i][j].getnid());
         }
@@ -259,24 +874,161 @@ std::vector<int>  TrashProblem::solutionAsVector() {
 }
 
 
+// read a solution written by solutionAsText() and warm start from it
+void TrashProblem::loadSolution(const std::string &file) {
+    std::ifstream in(file.c_str());
+    if (!in) {
+        std::string errmsg = "TrashProblem::loadSolution - can not open '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    warmStart(ss.str());
+}
+
+
+// Build the fleet from the routes of a previous solution in the format of
+// solutionAsText(), the depot and the pickups of each route followed by
+// -1, separated by commas or white space. The problem may have changed
+// since: pickups that are gone and pickups that no longer fit in their
+// truck are dropped, and the new pickups are put at their cheapest
+// feasible place. A route goes to its depot if that is still a free
+// depot, otherwise, or when the route names no depot, to the nearest
+// free depot of its first pickup. The improvement phase goes on from the
+// result.
+void TrashProblem::warmStart(const std::string &text) {
+    std::vector< std::vector<int> > routes(1);
+    std::stringstream ss(text);
+    std::string tok;
+    while (ss >> tok) {
+        std::stringstream ts(tok);
+        std::string item;
+        while (std::getline(ts, item, ',')) {
+            if (!item.size()) continue;
+            char *end;
+            long nid = strtol(item.c_str(), &end, 10);
+            if (*end) {
+                std::string errmsg = "TrashProblem::warmStart - '" + item + "' is not a node id.";
+                throw std::runtime_error(errmsg);
+            }
+            // no node of this problem, dropped below
+            if (nid < -1 or nid >= (long) datanodes.size())
+                nid = -2;
+            if (nid == -1)
+                routes.push_back(std::vector<int>());
+            else
+                routes.back().push_back(nid);
+        }
+    }
+    if (!routes.back().size()) routes.pop_back();
+
+    unassignAll();
+
+    clearFleet();
+
+    for (int i=0; i<depots.size(); i++) {
+        Vehicle truck(datanodes);
+        makeTruck(truck, depots[i]);
+        fleet.push_back(truck);
+    }
+
+    int kept = 0;
+    int dropped = 0;
+    std::vector<bool> seen(datanodes.size(), false);
+    std::vector<bool> used(depots.size(), false);
+    for (int k=0; k<routes.size(); k++) {
+        // the depot the route was driven from, if it still is one
+        int d = -1;
+        int first = 0;
+        if (routes[k].size() and routes[k][0] >= 0
+                and datanodes[routes[k][0]].isdepot()) {
+            for (int i=0; i<depots.size(); i++)
+                if (depots[i] == routes[k][0] and !used[i])
+                    d = i;
+            first = 1;
+        }
+
+        // the pickups of the route that still exist and were not seen yet
+        std::vector<int> nids;
+        for (int j=first; j<routes[k].size(); j++) {
+            int nid = routes[k][j];
+            if (nid < 0 or nid >= datanodes.size()
+                    or !datanodes[nid].ispickup() or seen[nid]) {
+                dropped++;
+                continue;
+            }
+            seen[nid] = true;
+            nids.push_back(nid);
+        }
+        if (!nids.size()) continue;
+
+        if (d == -1)
+            for (int i=0; i<depots.size(); i++)
+                if (!used[i] and (d == -1 or distance(depots[i], nids[0])
+                                             < distance(depots[d], nids[0])))
+                    d = i;
+
+        // no truck left, the pickups are inserted with the new ones
+        if (d == -1 or used[d]) continue;
+        used[d] = true;
+
+        Vehicle &truck(fleet[d]);
+        for (int j=0; j<nids.size(); j++) {
+            if (truck.getcurcapacity() + datanodes[nids[j]].getdemand()
+                    > truck.getmaxcapacity())
+                continue;
+            markAssigned(nids[j]);
+            truck.push_back(datanodes[nids[j]]);
+            kept++;
+        }
+    }
+
+    int placed = insertUnassigned();
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    std::cout << "warmStart: routes: " << routes.size()
+              << ", kept: " << kept
+              << ", dropped: " << dropped
+              << ", placed: " << placed << std::endl;
+
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::warmStart\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+void TrashProblem::unassignAll() {
+    unassigned.fill();
+    sindex.build(datanodes, pickups);
+}
+
+
+void TrashProblem::markAssigned(int nid) {
+    unassigned.reset(nid);
+    sindex.remove(nid);
+}
+
+
 void TrashProblem::nearestNeighbor() {
     // create a list of all pickup nodes and make them unassigned
-    unassigned = std::vector<int>(datanodes.size(), 1);
+    unassignAll();
 
     clearFleet();
 
     for (int i=0; i<depots.size(); i++) {
-        Vehicle truck;
+        Vehicle truck(datanodes);
 
         // add this depot as the vehicles home location
         Trashnode& depot(datanodes[depots[i]]);
         truck.setdepot(depot);
         // add the closest dump for now, this might change later
         truck.setdumpsite(datanodes[depot.getdumpnid()]);
-
-        // remember the last node we inserted
-        Trashnode& last_node = datanodes[depots[i]];
-
+        truck.setdmatrix(&dMatrix);
         truck.evaluate();
 
         while (truck.getcurcapacity() <= truck.getmaxcapacity()) {
@@ -289,9 +1041,8 @@ void TrashProblem::nearestNeighbor() {
             if (nnid == -1) break;
 
             // add node to route
-            unassigned[nnid] = 0;
+            markAssigned(nnid);
             truck.push_back(datanodes[nnid]);
-            truck.evaluate();
         }
         std::cout << "nearestNeighbor: depot: " << i << std::endl;
         truck.dump();
@@ -300,7 +1051,7 @@ void TrashProblem::nearestNeighbor() {
     // report unassigned nodes
     std::cout << "-------- Unassigned after TrashProblem::nearestNeighbor\n";
     for (int i=0; i<pickups.size(); i++) {
-        if (unassigned[pickups[i]])
+        if (unassigned.test(pickups[i]))
             std::cout << "    " << pickups[i] << std::endl;
     }
 }
@@ -310,39 +1061,407 @@ void TrashProblem::nearestNeighbor() {
 
 
 void TrashProblem::nearestInsertion() {
-
+    insertionHeuristic(false);
 }
 
 
 void TrashProblem::farthestInsertion() {
+    insertionHeuristic(true);
+}
+
 
+// distance added by putting nid between the stops at pos-1 and pos of v
+double TrashProblem::insertionCost(const Vehicle &v, int nid, int pos) const {
+    int prev = pos == 0 ? v.getdepot().getnid() : v.getnid(pos-1);
+    int next = pos == v.size() ? v.getdumpsite().getnid() : v.getnid(pos);
+    return dMatrix.get(prev, nid) + dMatrix.get(nid, next) - dMatrix.get(prev, next);
 }
 
 
-void TrashProblem::assignmentSweep() {
+// cheapest position for nid in v, pos is -1 if nid does not fit in v
+void TrashProblem::bestInsertion(const Vehicle &v, int nid, double *cost, int *pos) const {
+    *pos = -1;
+    if (v.getcurcapacity() + datanodes[nid].getdemand() > v.getmaxcapacity())
+        return;
+
+    for (int p=0; p<=v.size(); p++) {
+        double c = insertionCost(v, nid, p);
+        if (*pos == -1 or c < *cost) {
+            *cost = c;
+            *pos = p;
+        }
+    }
+}
+
+
+// cheapest position for nid in v that does not add time window
+// violations, -1 if there is none or nid does not fit
+int TrashProblem::feasiblePosition(const Vehicle &v, int nid) const {
+    double cost;
+    int pos, tw;
+
+    bestInsertion(v, nid, &cost, &pos);
+    if (pos == -1) return -1;
+
+    v.testInsert(datanodes[nid], pos, NULL, &tw);
+    if (tw <= v.getTWV()) return pos;
+
+    pos = -1;
+    for (int p=0; p<=v.size(); p++) {
+        v.testInsert(datanodes[nid], p, NULL, &tw);
+        if (tw > v.getTWV()) continue;
+
+        double c = insertionCost(v, nid, p);
+        if (pos == -1 or c < cost) {
+            cost = c;
+            pos = p;
+        }
+    }
+    return pos;
+}
+
+
+// cheapest position for nid in any of trucks that does not add time
+// window violations
+bool TrashProblem::feasibleInsertion(const std::vector<Vehicle> &trucks,
+                                     int nid, int *veh, int *pos) const {
+    double best = 0.0;
+    *veh = -1;
+
+    for (int v=0; v<trucks.size(); v++) {
+        int p = feasiblePosition(trucks[v], nid);
+        if (p == -1) continue;
+
+        double c = insertionCost(trucks[v], nid, p);
+        if (*veh == -1 or c < best) {
+            best = c;
+            *veh = v;
+            *pos = p;
+        }
+    }
+
+    return *veh != -1;
+}
+
+
+// Cheapest (farthest == false) or farthest insertion over all vehicles.
+//
+// cost[nid*nv+v] and at[nid*nv+v] hold the cheapest insertion of each
+// pickup into each vehicle and best[nid] the vehicle where that is
+// cheapest. The heap holds the best cost of each pickup, the node with the
+// lowest (highest for farthest) cost is inserted next. Entries are not
+// removed from the heap when a cost changes, a new one is pushed and the
+// old one is skipped when it comes up because it no longer matches.
+//
+// Inserting x at pos in route r only splits the edge at pos. So for each
+// pickup only its entry for r is looked at again: a full rescan of r if
+// its cheapest position was the edge that was split, otherwise a check of
+// the two new edges.
+void TrashProblem::insertionHeuristic(bool farthest) {
+    const char *name = farthest ? "farthestInsertion" : "nearestInsertion";
+
     // create a list of all pickup nodes and make them unassigned
-    unassigned = std::vector<int>(datanodes.size(), 1);
+    unassignAll();
 
     clearFleet();
 
     for (int i=0; i<depots.size(); i++) {
-        Vehicle truck;
+        Vehicle truck(datanodes);
 
         // add this depot as the vehicles home location
         Trashnode& depot(datanodes[depots[i]]);
         truck.setdepot(depot);
         // add the closest dump for now, this might change later
         truck.setdumpsite(datanodes[depot.getdumpnid()]);
+        truck.setdmatrix(&dMatrix);
         truck.evaluate();
+        fleet.push_back(truck);
+    }
 
-        int pos;
-        int nid = findNearestNodeTo(truck, UNASSIGNED|PICKUP|CLUSTER1, 0, &pos);
-        if (nid == -1) {
-            std::cout << "TrashProblem::assignmentSweep failed to find an initial node for depot: " << depots[i] << std::endl;
+    int nv = fleet.size();
+    std::vector<double> cost(datanodes.size() * nv, 0.0);
+    std::vector<int> at(datanodes.size() * nv, -1);
+    std::vector<int> best(datanodes.size(), -1);
+    std::priority_queue< std::pair<double, int> > heap;
+    double sign = farthest ? 1.0 : -1.0;
+
+    for (int i=0; i<pickups.size(); i++) {
+        int nid = pickups[i];
+        for (int v=0; v<nv; v++) {
+            int k = nid * nv + v;
+            bestInsertion(fleet[v], nid, &cost[k], &at[k]);
+            if (at[k] != -1 and (best[nid] == -1 or cost[k] < cost[nid*nv+best[nid]]))
+                best[nid] = v;
+        }
+        if (best[nid] != -1)
+            heap.push(std::make_pair(sign * cost[nid*nv+best[nid]], nid));
+    }
+
+    while (!heap.empty()) {
+        int nid = heap.top().second;
+        double key = heap.top().first;
+        heap.pop();
+
+        if (!unassigned.test(nid) or best[nid] == -1) continue;
+        if (key != sign * cost[nid*nv+best[nid]]) continue;
+
+        int r = best[nid];
+        int pos = at[nid*nv+r];
+
+        // only insert where it does not add time window violations
+        int tw;
+        fleet[r].testInsert(datanodes[nid], pos, NULL, &tw);
+        if (tw > fleet[r].getTWV() and !feasibleInsertion(fleet, nid, &r, &pos)) {
+            std::cout << name << ": no feasible position for: " << nid << std::endl;
+            best[nid] = -1;
+            continue;
+        }
+
+        Vehicle &truck(fleet[r]);
+        markAssigned(nid);
+        truck.insert(truck.begin()+pos, datanodes[nid]);
+
+        for (int i=0; i<pickups.size(); i++) {
+            int p = pickups[i];
+            if (!unassigned.test(p) or best[p] == -1) continue;
+
+            int k = p * nv + r;
+            int b = best[p];
+            double old = cost[p*nv+b];
+
+            if (at[k] != -1) {
+                if (truck.getcurcapacity() + datanodes[p].getdemand() > truck.getmaxcapacity())
+                    at[k] = -1;
+                else if (at[k] == pos)
+                    bestInsertion(truck, p, &cost[k], &at[k]);
+                else {
+                    if (at[k] > pos) at[k]++;
+                    for (int q=pos; q<=pos+1; q++) {
+                        double c = insertionCost(truck, p, q);
+                        if (c < cost[k]) {
+                            cost[k] = c;
+                            at[k] = q;
+                        }
+                    }
+                }
+            }
+
+            // the best vehicle can only change if it was or now is r
+            if (b != r and (at[k] == -1 or cost[k] >= old))
+                continue;
+
+            best[p] = -1;
+            for (int v=0; v<nv; v++) {
+                int kv = p * nv + v;
+                if (at[kv] != -1 and (best[p] == -1 or cost[kv] < cost[p*nv+best[p]]))
+                    best[p] = v;
+            }
+            if (best[p] != -1 and (best[p] != b or cost[p*nv+best[p]] != old))
+                heap.push(std::make_pair(sign * cost[p*nv+best[p]], p));
+        }
+    }
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    for (int i=0; i<fleet.size(); i++) {
+        std::cout << name << ": depot: " << i << std::endl;
+        fleet[i].dump();
+    }
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::" << name << "\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+// Sweep construction.
+//
+// The pickups of each depot (the ones with it as depotnid) are sorted
+// once by their polar angle around the depot. A sweep starts at some
+// angle and goes around each depot appending the pickups in angle order
+// to the end of the route, skipping the ones that would overload the
+// truck or add time window violations, so a sweep is linear after the
+// sort. What is left over is then put at its cheapest position in any
+// truck it still fits.
+//
+// Where the sweep starts decides which pickups are left for the other
+// trucks, so SWEEPS sweeps from evenly spaced start angles are run by a
+// pool of threads and the one that routes the most pickups at the lowest
+// cost is kept.
+
+const int SWEEPS = 8;
+
+void TrashProblem::assignmentSweep() {
+    // create a list of all pickup nodes and make them unassigned
+    unassignAll();
+
+    clearFleet();
+
+    if (!pickups.size() or !depots.size()) return;
+
+    std::vector<int> depotidx(datanodes.size(), -1);
+    for (int i=0; i<depots.size(); i++)
+        depotidx[depots[i]] = i;
+
+    // pickups of each depot sorted by angle, as (angle, nid)
+    std::vector< std::vector< std::pair<double, int> > > sorted(depots.size());
+    for (int i=0; i<pickups.size(); i++) {
+        const Trashnode &n(datanodes[pickups[i]]);
+        int nd = n.getdepotnid();
+        int d = nd >= 0 and nd < depotidx.size() ? depotidx[nd] : -1;
+        if (d == -1) continue;
+        const Trashnode &depot(datanodes[depots[d]]);
+        double angle = atan2(n.gety() - depot.gety(), n.getx() - depot.getx());
+        sorted[d].push_back(std::make_pair(angle, n.getnid()));
+    }
+    for (int d=0; d<depots.size(); d++)
+        std::sort(sorted[d].begin(), sorted[d].end());
+
+    std::vector< std::vector<Vehicle> > results(SWEEPS);
+    std::vector<int> routed(SWEEPS);
+
+    int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+    if (nt < 1) nt = 1;
+    if (nt > SWEEPS) nt = SWEEPS;
+
+    std::atomic<int> counter(0);
+    std::vector<std::thread> workers;
+    for (int t=1; t<nt; t++)
+        workers.push_back(std::thread(&TrashProblem::sweepAngles, this,
+                          std::cref(sorted), std::ref(results),
+                          std::ref(routed), &counter));
+    sweepAngles(sorted, results, routed, &counter);
+    for (int t=0; t<workers.size(); t++)
+        workers[t].join();
+
+    int best = 0;
+    double bestcost = 0.0;
+    for (int k=0; k<SWEEPS; k++) {
+        double cost = 0.0;
+        for (int i=0; i<results[k].size(); i++)
+            cost += results[k][i].getcost();
+        std::cout << "assignmentSweep: sweep: " << k << ", routed: "
+                  << routed[k] << ", cost: " << cost << std::endl;
+        if (k == 0 or routed[k] > routed[best]
+                or (routed[k] == routed[best] and cost < bestcost)) {
+            best = k;
+            bestcost = cost;
+        }
+    }
+
+    fleet = results[best];
+    for (int i=0; i<fleet.size(); i++)
+        for (int j=0; j<fleet[i].size(); j++)
+            markAssigned(fleet[i].getnid(j));
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    for (int i=0; i<fleet.size(); i++) {
+        std::cout << "assignmentSweep: depot: " << i << std::endl;
+        fleet[i].dump();
+    }
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::assignmentSweep\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+// worker for assignmentSweep(), takes sweeps off *next until none are
+// left. Sweep k starts at the angle -pi + 2*pi*k/SWEEPS.
+void TrashProblem::sweepAngles(
+        const std::vector< std::vector< std::pair<double, int> > > &sorted,
+        std::vector< std::vector<Vehicle> > &results,
+        std::vector<int> &routed, std::atomic<int> *next) const {
+
+    while (true) {
+        int k = next->fetch_add(1);
+        if (k >= SWEEPS) break;
+
+        std::vector<Vehicle> &trucks(results[k]);
+        std::vector<int> left;
+        double start = -M_PI + 2.0 * M_PI * k / SWEEPS;
+
+        routed[k] = 0;
+        for (int d=0; d<depots.size(); d++) {
+            Vehicle truck(datanodes);
+
+            // add this depot as the vehicles home location
+            const Trashnode& depot(datanodes[depots[d]]);
+            truck.setdepot(depot);
+            // add the closest dump for now, this might change later
+            truck.setdumpsite(datanodes[depot.getdumpnid()]);
+            truck.setdmatrix(&dMatrix);
+            truck.evaluate();
+
+            const std::vector< std::pair<double, int> > &ring(sorted[d]);
+            int n = ring.size();
+            int first = std::lower_bound(ring.begin(), ring.end(),
+                            std::make_pair(start, -1)) - ring.begin();
+
+            for (int i=0; i<n; i++) {
+                int nid = ring[(first + i) % n].second;
+                const Trashnode &node(datanodes[nid]);
+                int tw;
+                bool fits = truck.getcurcapacity() + node.getdemand()
+                            <= truck.getmaxcapacity();
+                if (fits) {
+                    truck.testInsert(node, truck.size(), NULL, &tw);
+                    fits = tw <= truck.getTWV();
+                }
+                if (!fits) {
+                    left.push_back(nid);
+                    continue;
+                }
+                truck.push_back(node);
+                routed[k]++;
+            }
+            trucks.push_back(truck);
+        }
+
+        for (int i=0; i<left.size(); i++) {
+            int v, pos;
+            if (!feasibleInsertion(trucks, left[i], &v, &pos)) continue;
+            trucks[v].insert(trucks[v].begin()+pos, datanodes[left[i]]);
+            routed[k]++;
+        }
+    }
+}
+
+
+// grow each truck from its depot by adding the unassigned pickup nearest
+// to its path until it is full
+void TrashProblem::segmentInsertion() {
+    // create a list of all pickup nodes and make them unassigned
+    unassignAll();
+
+    clearFleet();
+
+    for (int i=0; i<depots.size(); i++) {
+        Vehicle truck(datanodes);
+
+        // add this depot as the vehicles home location
+        Trashnode& depot(datanodes[depots[i]]);
+        truck.setdepot(depot);
+        // add the closest dump for now, this might change later
+        truck.setdumpsite(datanodes[depot.getdumpnid()]);
+        truck.setdmatrix(&dMatrix);
+        truck.evaluate();
+
+        int pos;
+        int nid = findNearestNodeTo(truck, UNASSIGNED|PICKUP|CLUSTER1, 0, &pos);
+        if (nid == -1) {
+            std::cout << "TrashProblem::segmentInsertion failed to find an initial node for depot: " << depots[i] << std::endl;
             continue;
         }
         truck.push_back(datanodes[nid]);
-        unassigned[nid] = 0;
+        markAssigned(nid);
 
         while (truck.getcurcapacity() <= truck.getmaxcapacity()) {
 
@@ -355,8 +1474,7 @@ void TrashProblem::assignmentSweep() {
             if (nnid == -1) break;
 
             // add node to route
-            unassigned[nnid] = 0;
-            truck.push_back(datanodes[nnid]);
+            markAssigned(nnid);
             if (pos == 0)
                 truck.push_front(datanodes[nnid]);
             else if (pos == truck.size())
@@ -364,32 +1482,959 @@ void TrashProblem::assignmentSweep() {
             else 
                 truck.insert(truck.begin()+pos, datanodes[nnid]);
 
-            truck.evaluate();
+            // the segment at pos was split in two
+            sindex.insertSegment(pos);
         }
-        std::cout << "assignmentSweep: depot: " << i << std::endl;
+        std::cout << "segmentInsertion: depot: " << i << std::endl;
         truck.dump();
         fleet.push_back(truck);
     }
     // report unassigned nodes
-    std::cout << "-------- Unassigned after TrashProblem::assignmentSweep\n";
+    std::cout << "-------- Unassigned after TrashProblem::segmentInsertion\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+// Cluster first, route second.
+//
+// The pickups are split between the depots by assignClusters(), then the
+// route of each depot is built and improved on its own by one of a pool
+// of threads. The threads only touch their own Vehicle and read the
+// nodes, dMatrix and neighbors, which are not changed while they run.
+// Last repairBoundaries() moves pickups between neighboring clusters and
+// places any that did not fit anywhere.
+void TrashProblem::clusterFirst() {
+    // create a list of all pickup nodes and make them unassigned
+    unassignAll();
+
+    clearFleet();
+
+    if (neighbors.size() != datanodes.size())
+        buildNeighbors(10);
+
+    for (int i=0; i<depots.size(); i++) {
+        Vehicle truck(datanodes);
+
+        // add this depot as the vehicles home location
+        Trashnode& depot(datanodes[depots[i]]);
+        truck.setdepot(depot);
+        // add the closest dump for now, this might change later
+        truck.setdumpsite(datanodes[depot.getdumpnid()]);
+        truck.setdmatrix(&dMatrix);
+        truck.evaluate();
+        fleet.push_back(truck);
+    }
+
+    std::vector< std::vector<int> > parts;
+    std::vector< std::vector<int> > left(depots.size());
+    assignClusters(parts);
+
+    int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+    if (nt < 1) nt = 1;
+    if (nt > depots.size()) nt = depots.size();
+
+    std::atomic<int> counter(0);
+    std::vector<std::thread> workers;
+    for (int t=1; t<nt; t++)
+        workers.push_back(std::thread(&TrashProblem::routeClusters, this,
+                          std::cref(parts), std::ref(left), &counter));
+    routeClusters(parts, left, &counter);
+    for (int t=0; t<workers.size(); t++)
+        workers[t].join();
+
+    for (int i=0; i<fleet.size(); i++)
+        for (int j=0; j<fleet[i].size(); j++)
+            markAssigned(fleet[i].getnid(j));
+
+    int moves = repairBoundaries();
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    for (int i=0; i<fleet.size(); i++) {
+        std::cout << "clusterFirst: depot: " << i
+                  << ", cluster: " << parts[i].size()
+                  << ", not routed: " << left[i].size() << std::endl;
+        fleet[i].dump();
+    }
+    std::cout << "clusterFirst: boundary moves: " << moves << std::endl;
+
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::clusterFirst\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+// Give each pickup to its nearest depot, or to its second nearest if the
+// truck of the nearest one is full. The pickups that lose the most by not
+// going to the nearest depot choose first. parts[i] gets the pickups of
+// depots[i], pickups that fit in neither truck are left out.
+void TrashProblem::assignClusters(std::vector< std::vector<int> > &parts) const {
+    std::vector<int> depotidx(datanodes.size(), -1);
+    for (int i=0; i<depots.size(); i++)
+        depotidx[depots[i]] = i;
+
+    std::vector< std::pair<double, int> > order;
+    for (int i=0; i<pickups.size(); i++) {
+        const Trashnode &n(datanodes[pickups[i]]);
+        double regret = n.getdepotnid2() == -1
+                        ? std::numeric_limits<double>::max()
+                        : n.getdepotdist2() - n.getdepotdist();
+        order.push_back(std::make_pair(-regret, n.getnid()));
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<int> load(depots.size(), 0);
+    parts.assign(depots.size(), std::vector<int>());
+
+    for (int i=0; i<order.size(); i++) {
+        const Trashnode &n(datanodes[order[i].second]);
+        long int choice[2] = { n.getdepotnid(), n.getdepotnid2() };
+
+        for (int c=0; c<2; c++) {
+            if (choice[c] == -1) continue;
+            int d = depotidx[choice[c]];
+            if (load[d] + n.getdemand() > datanodes[depots[d]].getdemand())
+                continue;
+            load[d] += n.getdemand();
+            parts[d].push_back(n.getnid());
+            break;
+        }
+    }
+}
+
+
+// worker for clusterFirst(), takes depots off *next until none are left
+void TrashProblem::routeClusters(const std::vector< std::vector<int> > &parts,
+                                 std::vector< std::vector<int> > &left,
+                                 std::atomic<int> *next) {
+    Routeopt ro(datanodes, dMatrix, neighbors);
+
+    while (true) {
+        int d = next->fetch_add(1);
+        if (d >= fleet.size()) break;
+
+        buildRoute(fleet[d], parts[d], left[d]);
+        improveRoute(fleet[d], ro);
+    }
+}
+
+
+// cheapest insertion of nids into truck, nids that can only go in by
+// adding time window violations are put in left
+void TrashProblem::buildRoute(Vehicle &truck, const std::vector<int> &nids,
+                              std::vector<int> &left) const {
+    int n = nids.size();
+    std::vector<double> cost(n);
+    std::vector<int> at(n);
+    std::vector<char> done(n, 0);
+
+    for (int i=0; i<n; i++)
+        bestInsertion(truck, nids[i], &cost[i], &at[i]);
+
+    for (int step=0; step<n; step++) {
+        int b = -1;
+        for (int i=0; i<n; i++)
+            if (!done[i] and at[i] != -1 and (b == -1 or cost[i] < cost[b]))
+                b = i;
+        if (b == -1) break;
+        done[b] = 1;
+
+        int pos = at[b];
+        int tw;
+        truck.testInsert(datanodes[nids[b]], pos, NULL, &tw);
+        if (tw > truck.getTWV())
+            pos = feasiblePosition(truck, nids[b]);
+        if (pos == -1) {
+            left.push_back(nids[b]);
+            continue;
+        }
+
+        truck.insert(truck.begin()+pos, datanodes[nids[b]]);
+
+        // only the edge at pos was split, see insertionHeuristic()
+        for (int i=0; i<n; i++) {
+            if (done[i] or at[i] == -1) continue;
+            if (at[i] == pos)
+                bestInsertion(truck, nids[i], &cost[i], &at[i]);
+            else {
+                if (at[i] > pos) at[i]++;
+                for (int q=pos; q<=pos+1; q++) {
+                    double c = insertionCost(truck, nids[i], q);
+                    if (c < cost[i]) {
+                        cost[i] = c;
+                        at[i] = q;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int i=0; i<n; i++)
+        if (!done[i])
+            left.push_back(nids[i]);
+}
+
+
+// distance saved by taking the stop at pos out of v
+double TrashProblem::removalGain(const Vehicle &v, int pos) const {
+    int nid = v.getnid(pos);
+    int prev = pos == 0 ? v.getdepot().getnid() : v.getnid(pos-1);
+    int next = pos == v.size()-1 ? v.getdumpsite().getnid() : v.getnid(pos+1);
+    return dMatrix.get(prev, nid) + dMatrix.get(nid, next) - dMatrix.get(prev, next);
+}
+
+
+// Move pickups to the route of their other nearest depot while that makes
+// the routes shorter without adding time window violations, then place
+// the pickups that are still unassigned. Returns the number of moves.
+int TrashProblem::repairBoundaries() {
+    std::vector<int> vehicleof(datanodes.size(), -1);
+    for (int i=0; i<fleet.size(); i++)
+        vehicleof[fleet[i].getdepot().getnid()] = i;
+
+    int moves = 0;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int a=0; a<fleet.size(); a++) {
+            Vehicle &from(fleet[a]);
+            for (int j=0; j<from.size(); j++) {
+                int nid = from.getnid(j);
+                const Trashnode &n(datanodes[nid]);
+                long int other = n.getdepotnid() == from.getdepot().getnid()
+                                 ? n.getdepotnid2() : n.getdepotnid();
+                if (other == -1 or vehicleof[other] == -1) continue;
+
+                Vehicle &to(fleet[vehicleof[other]]);
+                double cost;
+                int pos;
+                bestInsertion(to, nid, &cost, &pos);
+                if (pos == -1 or cost >= removalGain(from, j) - 1e-7)
+                    continue;
+
+                int tw;
+                to.testInsert(n, pos, NULL, &tw);
+                if (tw > to.getTWV()) continue;
+
+                from.erase(from.begin()+j);
+                to.insert(to.begin()+pos, n);
+                moves++;
+                improved = true;
+                j--;
+            }
+        }
+    }
+
+    return moves + insertUnassigned();
+}
+
+
+// put the unassigned pickups where they fit without adding time window
+// violations, returns how many were placed
+int TrashProblem::insertUnassigned() {
+    int placed = 0;
+    for (int i=0; i<pickups.size(); i++) {
+        int nid = pickups[i];
+        int v, pos;
+        if (!unassigned.test(nid) or !feasibleInsertion(fleet, nid, &v, &pos))
+            continue;
+        markAssigned(nid);
+        fleet[v].insert(fleet[v].begin()+pos, datanodes[nid]);
+        placed++;
+    }
+    return placed;
+}
+
+
+// Clarke and Wright savings.
+//
+// Every pickup starts in a route of its own, depot, pickup, dump, depot,
+// on its nearest depot. Linking the end i of one route to the start j of
+// another route of the same depot saves
+//
+//     s(i,j) = d(i,dump) + d(dump,depot) + d(depot,j) - d(i,j)
+//
+// Savings are only computed for the k nearest neighbors of each pickup,
+// split over the thread pool, and the merges are done from a heap of
+// them. A merge is only done if the merged route fits in the truck and
+// does not have more time window violations than the two routes had.
+// Routes are tracked with a union-find over the pickups.
+//
+// The time window check is O(1) per saving. For each route, stored on its
+// root, we keep:
+//
+//     start   when service starts at its first pickup
+//     dur     service and travel time from there to leaving the last pickup
+//     rel     so that starting at t we leave the last pickup at
+//             max(t + dur, rel), waiting for windows is all in rel
+//     lss     latest start that adds no violations at the pickups
+//     ls      the same with the dump and the depot at the end
+//
+// Starting later never makes a stop earlier, so a route a followed by b
+// has no more violations than a and b had as long as service at the
+// first pickup of b does not start after ls of b. The values of the
+// merged route follow from those of a and b.
+//
+// Each depot has one truck, so the route of a depot with the most load
+// is kept and the pickups of its other routes are put in whatever truck
+// they still fit.
+void TrashProblem::clarkeWright() {
+    // create a list of all pickup nodes and make them unassigned
+    unassignAll();
+
+    clearFleet();
+
+    if (neighbors.size() != datanodes.size())
+        buildNeighbors(10);
+
+    int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+    if (nt < 1) nt = 1;
+    if (nt > pickups.size()) nt = pickups.size();
+    if (nt < 1) nt = 1;
+
+    std::vector< std::vector<Saving> > parts(nt);
+    std::vector<std::thread> workers;
+    int chunk = (pickups.size() + nt - 1) / nt;
+    for (int t=1; t<nt; t++)
+        workers.push_back(std::thread(&TrashProblem::computeSavings, this,
+                          t * chunk, std::min((int) pickups.size(), (t+1) * chunk),
+                          std::ref(parts[t])));
+    computeSavings(0, std::min((int) pickups.size(), chunk), parts[0]);
+    for (int t=0; t<workers.size(); t++)
+        workers[t].join();
+
+    std::vector<Saving> heap;
+    for (int t=0; t<nt; t++)
+        heap.insert(heap.end(), parts[t].begin(), parts[t].end());
+    std::make_heap(heap.begin(), heap.end());
+    int nsavings = heap.size();
+
+    // route of each pickup, the data of a route is kept on its root
+    const double LATE = std::numeric_limits<double>::max();
+    std::vector<int> parent(datanodes.size());
+    std::vector< std::vector<int> > seq(datanodes.size());
+    std::vector<int> load(datanodes.size(), 0);
+    std::vector<double> start(datanodes.size());
+    std::vector<double> dur(datanodes.size());
+    std::vector<double> rel(datanodes.size());
+    std::vector<double> lss(datanodes.size());
+    std::vector<double> ls(datanodes.size());
+
+    for (int i=0; i<pickups.size(); i++) {
+        int nid = pickups[i];
+        const Trashnode &p(datanodes[nid]);
+        parent[nid] = nid;
+        seq[nid].push_back(nid);
+        load[nid] = p.getdemand();
+        start[nid] = std::max((double) p.opens(),
+                              distance(p.getdepotnid(), nid));
+        dur[nid] = p.getservicetime();
+        rel[nid] = p.opens() + dur[nid];
+        // a stop that is late already can not add a violation
+        lss[nid] = p.latearrival(start[nid]) ? LATE : p.closes();
+        ls[nid] = std::min(lss[nid], latestFinish(p.getdepotnid(), nid,
+                                         start[nid] + dur[nid]) - dur[nid]);
+    }
+
+    int merges = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        Saving s = heap.back();
+        heap.pop_back();
+
+        int a = findRoute(parent, s.from);
+        int b = findRoute(parent, s.to);
+        if (a == b or seq[a].back() != s.from or seq[b].front() != s.to)
+            continue;
+
+        long int depotnid = datanodes[s.from].getdepotnid();
+        if (load[a] + load[b] > datanodes[depotnid].getdemand())
+            continue;
+
+        double d = distance(s.from, s.to);
+        double leave = std::max(start[a] + dur[a], rel[a]);
+        if (std::max((double) datanodes[s.to].opens(), leave + d) > ls[b])
+            continue;
+
+        double mdur = dur[a] + d + dur[b];
+        double mrel = std::max(rel[a] + d + dur[b], rel[b]);
+        double mlss = std::min(lss[a], lss[b] - d - dur[a]);
+        double mls = std::min(mlss, latestFinish(depotnid, seq[b].back(),
+                              std::max(start[a] + mdur, mrel)) - mdur);
+
+        // keep the longer sequence on the root so less is copied
+        int root = a, other = b;
+        if (seq[b].size() > seq[a].size()) {
+            root = b;
+            other = a;
+        }
+        if (root == a)
+            seq[a].insert(seq[a].end(), seq[b].begin(), seq[b].end());
+        else
+            seq[b].insert(seq[b].begin(), seq[a].begin(), seq[a].end());
+        std::vector<int>().swap(seq[other]);
+        parent[other] = root;
+        load[root] = load[a] + load[b];
+        start[root] = start[a];
+        dur[root] = mdur;
+        rel[root] = mrel;
+        lss[root] = mlss;
+        ls[root] = mls;
+        merges++;
+    }
+
+    // keep the route with the most load of each depot
+    std::vector<int> keep(datanodes.size(), -1);
+    for (int i=0; i<pickups.size(); i++) {
+        int r = findRoute(parent, pickups[i]);
+        if (r != pickups[i]) continue;
+        long int d = datanodes[r].getdepotnid();
+        if (keep[d] == -1 or load[r] > load[keep[d]])
+            keep[d] = r;
+    }
+
+    for (int i=0; i<depots.size(); i++) {
+        Vehicle truck(datanodes);
+        makeTruck(truck, depots[i]);
+        int r = keep[depots[i]];
+        if (r != -1)
+            for (int k=0; k<seq[r].size(); k++) {
+                truck.push_back(datanodes[seq[r][k]]);
+                markAssigned(seq[r][k]);
+            }
+        fleet.push_back(truck);
+    }
+
+    insertUnassigned();
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    std::cout << "clarkeWright: savings: " << nsavings
+              << ", merges: " << merges << std::endl;
+    for (int i=0; i<fleet.size(); i++) {
+        std::cout << "clarkeWright: depot: " << i << std::endl;
+        fleet[i].dump();
+    }
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::clarkeWright\n";
     for (int i=0; i<pickups.size(); i++) {
-        if (unassigned[pickups[i]])
+        if (unassigned.test(pickups[i]))
             std::cout << "    " << pickups[i] << std::endl;
     }
 }
 
 
+// positive savings of linking pickups[first..last) to their neighbors
+// of the same depot, in both directions
+void TrashProblem::computeSavings(int first, int last, std::vector<Saving> &out) const {
+    for (int p=first; p<last; p++) {
+        const Trashnode &a(datanodes[pickups[p]]);
+        int depot = a.getdepotnid();
+        int dump = datanodes[depot].getdumpnid();
+        double back = dMatrix.get(dump, depot);
+        const std::vector<int> &nb(neighbors[a.getnid()]);
+
+        for (int k=0; k<nb.size(); k++) {
+            const Trashnode &b(datanodes[nb[k]]);
+            if (b.getdepotnid() != depot) continue;
+
+            double dab = dMatrix.get(a.getnid(), b.getnid());
+            Saving s;
+
+            s.value = dMatrix.get(a.getnid(), dump) + back
+                      + dMatrix.get(depot, b.getnid()) - dab;
+            s.from = a.getnid();
+            s.to = b.getnid();
+            if (s.value > 0.0) out.push_back(s);
+
+            s.value = dMatrix.get(b.getnid(), dump) + back
+                      + dMatrix.get(depot, a.getnid()) - dab;
+            s.from = b.getnid();
+            s.to = a.getnid();
+            if (s.value > 0.0) out.push_back(s);
+        }
+    }
+}
+
+
+// root of the route of nid, with path halving
+int TrashProblem::findRoute(std::vector<int> &parent, int nid) {
+    while (parent[nid] != nid) {
+        parent[nid] = parent[parent[nid]];
+        nid = parent[nid];
+    }
+    return nid;
+}
+
+
+// latest time to leave last, the last pickup of a route of depotnid, that
+// adds no violations at the dump or the depot to those of leaving at dep
+double TrashProblem::latestFinish(int depotnid, int last, double dep) const {
+    const Trashnode &depot(datanodes[depotnid]);
+    const Trashnode &dump(datanodes[depot.getdumpnid()]);
+    double toDump = distance(last, dump.getnid());
+    double back = dump.getservicetime() + distance(dump.getnid(), depotnid);
+
+    double latest = std::numeric_limits<double>::max();
+    double arrive = dep + toDump;
+    if (!dump.latearrival(arrive))
+        latest = std::min(latest, dump.closes() - toDump);
+    if (!depot.latearrival(std::max(arrive, (double) dump.opens()) + back))
+        latest = std::min(latest, depot.closes() - back - toDump);
+    return latest;
+}
+
+
+// set up truck as the empty route of depotnid
+void TrashProblem::makeTruck(Vehicle &truck, int depotnid) const {
+    const Trashnode &depot(datanodes[depotnid]);
+    truck.setdepot(depot);
+    // add the closest dump for now, this might change later
+    truck.setdumpsite(datanodes[depot.getdumpnid()]);
+    truck.setdmatrix(&dMatrix);
+    truck.evaluate();
+}
+
+
+// Route all the pickups as one giant tour and cut it into one route per
+// depot. The tour is cheap to improve as a single TSP, without capacities
+// or time windows, and the split then finds the best routes that keep
+// the tour order. Pickups the split can not fit are inserted afterwards
+// and every route is improved on its own with time windows.
+void TrashProblem::giantTour() {
+    unassignAll();
+
+    clearFleet();
+
+    if (neighbors.size() != datanodes.size())
+        buildNeighbors(10);
+
+    for (int i=0; i<depots.size(); i++) {
+        Vehicle truck(datanodes);
+        makeTruck(truck, depots[i]);
+        fleet.push_back(truck);
+    }
+
+    std::vector<int> tour;
+    int moves = buildTour(tour);
+
+    // the depots take turns along the tour in the order of the tour
+    // position of their nearest pickup
+    std::vector< std::pair<int, int> > turns;
+    for (int i=0; i<depots.size(); i++) {
+        int at = 0;
+        for (int j=1; j<tour.size(); j++)
+            if (distance(depots[i], tour[j]) < distance(depots[i], tour[at]))
+                at = j;
+        turns.push_back(std::make_pair(at, i));
+    }
+    std::sort(turns.begin(), turns.end());
+    std::vector<int> order;
+    for (int i=0; i<turns.size(); i++)
+        order.push_back(turns[i].second);
+
+    std::vector<int> cut;
+    int served = splitTour(tour, order, cut);
+
+    for (int k=0; k<order.size(); k++) {
+        Vehicle &truck(fleet[order[k]]);
+        for (int j=cut[k]; j<cut[k+1]; j++) {
+            markAssigned(tour[j]);
+            truck.push_back(datanodes[tour[j]]);
+        }
+    }
+
+    int placed = insertUnassigned();
+
+    Routeopt ro(datanodes, dMatrix, neighbors);
+    for (int i=0; i<fleet.size(); i++)
+        improveRoute(fleet[i], ro);
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    std::cout << "giantTour: pickups: " << tour.size()
+              << ", tour moves: " << moves
+              << ", split: " << served
+              << ", placed: " << placed << std::endl;
+    for (int i=0; i<fleet.size(); i++) {
+        std::cout << "giantTour: depot: " << i << std::endl;
+        fleet[i].dump();
+    }
+
+    // report unassigned nodes
+    std::cout << "-------- Unassigned after TrashProblem::giantTour\n";
+    for (int i=0; i<pickups.size(); i++) {
+        if (unassigned.test(pickups[i]))
+            std::cout << "    " << pickups[i] << std::endl;
+    }
+}
+
+
+// nearest neighbor tour of all the pickups from the first depot, improved
+// with the 2-opt and Or-opt moves of Routeopt. Returns the number of moves.
+int TrashProblem::buildTour(std::vector<int> &tour) {
+    tour.clear();
+    if (!pickups.size() or !depots.size()) return 0;
+
+    SegmentIndex grid;
+    grid.build(datanodes, pickups);
+
+    const Trashnode &home(datanodes[depots[0]]);
+    double x = home.getx();
+    double y = home.gety();
+    std::vector<int> nn;
+    while (grid.size()) {
+        grid.nearestToPoint(x, y, 1, -1, nn);
+        int nid = nn[0];
+        grid.remove(nid);
+        tour.push_back(nid);
+        x = datanodes[nid].getx();
+        y = datanodes[nid].gety();
+    }
+
+    std::vector<int> seq;
+    seq.push_back(home.getnid());
+    seq.insert(seq.end(), tour.begin(), tour.end());
+    seq.push_back(home.getdumpnid());
+    seq.push_back(home.getnid());
+
+    Routeopt ro(datanodes, dMatrix, neighbors);
+    ro.settwcheck(false);
+    ro.load(seq);
+    int moves = ro.optimize();
+
+    const std::vector<int> &opt = ro.getseq();
+    tour.assign(opt.begin()+1, opt.end()-2);
+    return moves;
+}
+
+
+// Split the tour into routes, depots[order[k]] serves tour[cut[k]..cut[k+1])
+// which can be empty. A route costs its distance from the depot along its
+// part of the tour to the dump and back home.
+//
+// best[j] is the cheapest way to serve tour[0..j) with the depots so far.
+// Adding a depot, a route that starts at i and ends at j costs
+//
+//     best[i] + d(home, tour[i]) - along[i]   +   along[j-1] + d(tour[j-1], dump) + ...
+//
+// the first part only depends on i and the second only on j. The starts
+// still within the capacity of the truck are kept in a deque ordered by the
+// first part, so each j takes the front and each i goes in and out once.
+// That is O(N) per depot. Returns how many pickups from the start of the
+// tour are served, what does not fit is left for the caller.
+int TrashProblem::splitTour(const std::vector<int> &tour,
+                            const std::vector<int> &order,
+                            std::vector<int> &cut) const {
+    int n = tour.size();
+    int nk = order.size();
+    const double INF = std::numeric_limits<double>::max();
+
+    // distance along the tour to each pickup and the load before it
+    std::vector<double> along(n+1, 0.0);
+    std::vector<int> load(n+1, 0);
+    for (int i=0; i<n; i++) {
+        if (i) along[i] = along[i-1] + distance(tour[i-1], tour[i]);
+        load[i+1] = load[i] + datanodes[tour[i]].getdemand();
+    }
+
+    std::vector<double> best(n+1, INF);
+    std::vector<double> next(n+1);
+    std::vector<double> head(n+1);
+    std::vector< std::vector<int> > from(nk, std::vector<int>(n+1));
+    std::deque<int> starts;
+    best[0] = 0.0;
+
+    for (int k=0; k<nk; k++) {
+        const Trashnode &home(datanodes[depots[order[k]]]);
+        int dump = home.getdumpnid();
+        int cap = home.getdemand();
+        double back = distance(dump, home.getnid());
+
+        starts.clear();
+        int i = 0;
+        for (int j=0; j<=n; j++) {
+            // the truck can always stay home
+            next[j] = best[j];
+            from[k][j] = j;
+            if (!j) continue;
+
+            for (; i<j; i++) {
+                if (best[i] == INF) continue;
+                head[i] = best[i] + distance(home.getnid(), tour[i]) - along[i];
+                while (starts.size() and head[starts.back()] >= head[i])
+                    starts.pop_back();
+                starts.push_back(i);
+            }
+            while (starts.size() and load[j] - load[starts.front()] > cap)
+                starts.pop_front();
+            if (!starts.size()) continue;
+
+            int s = starts.front();
+            double c = head[s] + along[j-1] + distance(tour[j-1], dump) + back;
+            if (c < next[j]) {
+                next[j] = c;
+                from[k][j] = s;
+            }
+        }
+        best.swap(next);
+    }
+
+    int served = n;
+    while (best[served] == INF) served--;
+
+    cut.assign(nk+1, 0);
+    cut[nk] = served;
+    for (int k=nk-1; k>=0; k--)
+        cut[k] = from[k][cut[k+1]];
+
+    return served;
+}
+
+
+void TrashProblem::buildNeighbors(int k) {
+    SegmentIndex grid;
+    grid.build(datanodes, pickups);
+    nneighbors = k;
+
+    neighbors.clear();
+    neighbors.resize(datanodes.size());
+    for (int i=0; i<pickups.size(); i++) {
+        const Trashnode &n(datanodes[pickups[i]]);
+        grid.nearestToPoint(n.getx(), n.gety(), k, n.getnid(),
+                            neighbors[pickups[i]]);
+    }
+}
+
+
+// the nneighbors pickups nearest to nid in order of distance
+void TrashProblem::nearestPickups(int nid, std::vector<int> &out) const {
+    std::vector< std::pair<double, int> > d;
+    for (int i=0; i<pickups.size(); i++)
+        if (pickups[i] != nid)
+            d.push_back(std::make_pair(
+                datanodes[nid].distance(datanodes[pickups[i]]), pickups[i]));
+
+    int k = std::min(nneighbors, (int) d.size());
+    std::partial_sort(d.begin(), d.begin()+k, d.end());
+    out.clear();
+    for (int i=0; i<k; i++)
+        out.push_back(d[i].second);
+}
+
+
+// keep the neighbor lists right after pickup nid was added or retired,
+// only the lists it gets into or drops out of are changed
+void TrashProblem::updateNeighbors(int nid) {
+    if (!nneighbors) return;
+    neighbors.resize(datanodes.size());
+
+    const Trashnode &tn(datanodes[nid]);
+    bool added = tn.ispickup();
+    if (added)
+        nearestPickups(nid, neighbors[nid]);
+    else
+        neighbors[nid].clear();
+
+    for (int i=0; i<pickups.size(); i++) {
+        int p = pickups[i];
+        if (p == nid) continue;
+        std::vector<int> &nb(neighbors[p]);
+
+        if (!added) {
+            if (std::find(nb.begin(), nb.end(), nid) != nb.end())
+                nearestPickups(p, nb);
+            continue;
+        }
+
+        const Trashnode &pn(datanodes[p]);
+        double d = pn.distance(tn);
+        if (nb.size() == nneighbors
+                and d >= pn.distance(datanodes[nb.back()]))
+            continue;
+        int j = nb.size();
+        while (j and pn.distance(datanodes[nb[j-1]]) > d) j--;
+        nb.insert(nb.begin()+j, nid);
+        if (nb.size() > nneighbors) nb.pop_back();
+    }
+}
+
+
+// improve the order of the stops of truck with 2-opt and Or-opt moves,
+// returns the number of moves
+int TrashProblem::improveRoute(Vehicle &truck, Routeopt &ro) const {
+    if (truck.size() < 2) return 0;
+
+    std::vector<int> seq;
+    seq.push_back(truck.getdepot().getnid());
+    for (int j=0; j<truck.size(); j++)
+        seq.push_back(truck.getnid(j));
+    seq.push_back(truck.getdumpsite().getnid());
+    seq.push_back(truck.getdepot().getnid());
+
+    ro.load(seq);
+    int moves = ro.optimize();
+    if (!moves) return 0;
+
+    const std::vector<int> &opt = ro.getseq();
+    truck.clear();
+    for (int j=1; j<opt.size()-2; j++)
+        truck.push_back(datanodes[opt[j]]);
+
+    return moves;
+}
+
+
+// improve each route on its own with 2-opt and Or-opt moves
 void TrashProblem::opt_2opt() {
+    if (neighbors.size() != datanodes.size())
+        buildNeighbors(10);
+
+    Routeopt ro(datanodes, dMatrix, neighbors);
 
+    for (int i=0; i<fleet.size(); i++) {
+        Vehicle &truck(fleet[i]);
+        double before = truck.getcost();
+        int moves = improveRoute(truck, ro);
+        if (!moves) continue;
+
+        std::cout << "opt_2opt: depot: " << truck.getdepot().getnid()
+                  << ", moves: " << moves
+                  << ", cost: " << before << " -> " << truck.getcost()
+                  << std::endl;
+    }
 }
 
-void TrashProblem::dumpDmatrix() const {
-    std::cout << "--------- dMatrix ------------" << std::endl;
-    for (int i=0; i<dMatrix.size(); i++) {
-        for (int j=0; j<dMatrix[i].size(); j++) {
-            std::cout << i << "\t" << j << "\t" << dMatrix[i][j] << std::endl;
+
+// vehicles whose depots are neighbors, that is some pickup of one of them
+// has the depot of the other as its depotnid or depotnid2, grouped in
+// rounds where no vehicle is in more than one pair
+void TrashProblem::neighborPairs(
+        std::vector< std::vector< std::pair<int, int> > > &rounds) const {
+    std::vector<int> vehicleof(datanodes.size(), -1);
+    for (int i=0; i<fleet.size(); i++)
+        vehicleof[fleet[i].getdepot().getnid()] = i;
+
+    std::set< std::pair<int, int> > pairs;
+    for (int a=0; a<fleet.size(); a++) {
+        for (int j=0; j<fleet[a].size(); j++) {
+            const Trashnode &n(datanodes[fleet[a].getnid(j)]);
+            long int depot[2] = { n.getdepotnid(), n.getdepotnid2() };
+            for (int k=0; k<2; k++) {
+                if (depot[k] == -1) continue;
+                int b = vehicleof[depot[k]];
+                if (b == -1 or b == a) continue;
+                pairs.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
         }
     }
+
+    rounds.clear();
+    std::vector<int> busy;
+    std::set< std::pair<int, int> >::iterator it;
+    for (it=pairs.begin(); it!=pairs.end(); it++) {
+        // first round where neither vehicle is used yet
+        int r = 0;
+        while (r < rounds.size()
+                and (busy[r * fleet.size() + it->first]
+                     or busy[r * fleet.size() + it->second]))
+            r++;
+        if (r == rounds.size()) {
+            rounds.push_back(std::vector< std::pair<int, int> >());
+            busy.resize(rounds.size() * fleet.size(), 0);
+        }
+        rounds[r].push_back(*it);
+        busy[r * fleet.size() + it->first] = 1;
+        busy[r * fleet.size() + it->second] = 1;
+    }
+}
+
+
+// worker for opt_interRoute(), takes pairs of round off *next until none
+// are left, the pairs do not share vehicles
+void TrashProblem::improvePairs(const std::vector< std::pair<int, int> > &round,
+                                std::atomic<int> *moves, std::atomic<int> *next) {
+    Interroute ir(datanodes, dMatrix, neighbors);
+
+    while (true) {
+        int p = next->fetch_add(1);
+        if (p >= round.size()) break;
+        *moves += ir.improve(fleet[round[p].first], fleet[round[p].second]);
+    }
+}
+
+
+// move pickups between the routes of neighboring depots with relocate,
+// swap and 2-opt* moves until no move shortens the routes, then put any
+// unassigned pickups where they fit. The pairs of each round are done in
+// parallel.
+void TrashProblem::opt_interRoute() {
+    if (neighbors.size() != datanodes.size())
+        buildNeighbors(10);
+
+    double before = 0.0;
+    for (int i=0; i<fleet.size(); i++)
+        before += fleet[i].getcost();
+
+    int placed = insertUnassigned();
+
+    std::vector< std::vector< std::pair<int, int> > > rounds;
+    neighborPairs(rounds);
+
+    int total = 0;
+    while (true) {
+        std::atomic<int> moves(0);
+
+        for (int r=0; r<rounds.size(); r++) {
+            int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+            if (nt < 1) nt = 1;
+            if (nt > rounds[r].size()) nt = rounds[r].size();
+
+            std::atomic<int> counter(0);
+            std::vector<std::thread> workers;
+            for (int t=1; t<nt; t++)
+                workers.push_back(std::thread(&TrashProblem::improvePairs, this,
+                                  std::cref(rounds[r]), &moves, &counter));
+            improvePairs(rounds[r], &moves, &counter);
+            for (int t=0; t<workers.size(); t++)
+                workers[t].join();
+        }
+
+        total += moves;
+        if (!moves) break;
+    }
+
+    // moving pickups around may have made room for the leftovers
+    placed += insertUnassigned();
+
+    // the routes changed behind the back of the segment cache
+    sindex.resetSegments(-1, -1, 0, 0);
+
+    double after = 0.0;
+    for (int i=0; i<fleet.size(); i++)
+        after += fleet[i].getcost();
+
+    std::cout << "opt_interRoute: pairs: ";
+    int npairs = 0;
+    for (int r=0; r<rounds.size(); r++)
+        npairs += rounds[r].size();
+    std::cout << npairs << ", rounds: " << rounds.size()
+              << ", moves: " << total << ", placed: " << placed
+              << ", cost: " << before << " -> " << after << std::endl;
+}
+
+
+void TrashProblem::dumpDmatrix() const {
+    dMatrix.dump();
 }
 
 
@@ -1,13 +1,21 @@
 #ifndef TRASHPROBLEM_H
 #define TRASHPROBLEM_H
 
+#include <atomic>
+#include <map>
 #include <string>
 #include <iostream>
 #include <vector>
 
+#include "cachefile.h"
+#include "dmatrix.h"
+#include "mmatrix.h"
+#include "nodeset.h"
 #include "trashnode.h"
 //#include "twpath.h"
 #include "vehicle.h"
+#include "segmentindex.h"
+#include "routeopt.h"
 
 enum Selector {
     ANY         =0,     // any
@@ -29,15 +37,130 @@ class TrashProblem {
     std::vector<int> dumps;
     std::vector<int> pickups;
 
-    std::vector<int> unassigned;
-
-    std::vector< std::vector<double> > dMatrix;
+    // node sets used to answer Selector queries a word at a time
+    Nodeset pickupset;
+    Nodeset depotset;
+    Nodeset dumpset;
+    Nodeset unassigned;                     // cleared as pickups get routed
+    std::map<long int, Nodeset> clusters;   // nodes with depotnid or depotnid2 == key
+    Nodeset candidates;                     // scratch for the node scans
+
+    Dmatrix dMatrix;
+    const Distprovider *provider;   // travel times to use, NULL for euclidean
+
+    bool usecache;          // read and write the file.cache sidecar
+    Cachefile cache;        // the mapped sidecar
+    Mmatrix cachedmatrix;   // the matrix in the sidecar, dMatrix is attached to it
+
+    SegmentIndex sindex;    // unassigned pickups for findNearestNodeTo(Vehicle)
+
+    // k nearest pickups of each pickup, used by the local search
+    std::vector< std::vector<int> > neighbors;
+    int nneighbors;         // k of buildNeighbors(), 0 if not built yet
+
+    std::vector<int> retired;   // nids of retired nodes, reused by addNode()
+
+    int nthreads;           // threads for the parallel heuristics, 0 = all cores
+
+    void unassignAll();
+    void markAssigned(int nid);
+    void buildNodesets();
+    void growNodesets(int n);
+    void addToClusters(int nid);
+    void removeFromClusters(int nid);
+    void reassign(int nid);
+    void nearestPickups(int nid, std::vector<int> &out) const;
+    void updateNeighbors(int nid);
+    void prefetchFacilities();
+    uint64_t cacheKey(const std::string &file) const;
+    bool loadCache(const std::string &file, uint64_t key);
+    void saveCache(const std::string &file, uint64_t key) const;
+    const Nodeset* findCluster(long int depotnid) const;
+    void addCluster(Nodeset &sel, long int depotnid) const;
+
+    // node scans compiled for a fixed selector, see findScans()
+    typedef int (TrashProblem::*NodeScan)(const Trashnode &tn, int selector,
+                                          int demandLimit, double *dist);
+    typedef int (TrashProblem::*PathScan)(const Vehicle &v, int selector,
+                                          int demandLimit, int *pos, double *dist);
+
+    // used by nearestInsertion() and farthestInsertion()
+    double insertionCost(const Vehicle &v, int nid, int pos) const;
+    void bestInsertion(const Vehicle &v, int nid, double *cost, int *pos) const;
+    int feasiblePosition(const Vehicle &v, int nid) const;
+    bool feasibleInsertion(const std::vector<Vehicle> &trucks, int nid,
+                           int *veh, int *pos) const;
+    void insertionHeuristic(bool farthest);
+
+    // used by assignmentSweep()
+    void sweepAngles(
+            const std::vector< std::vector< std::pair<double, int> > > &sorted,
+            std::vector< std::vector<Vehicle> > &results,
+            std::vector<int> &routed, std::atomic<int> *next) const;
+
+    // used by clarkeWright()
+    struct Saving {
+        double value;
+        int from;       // last pickup of the first route
+        int to;         // first pickup of the second route
+        bool operator<(const Saving &s) const {
+            if (value != s.value) return value < s.value;
+            if (from != s.from) return from > s.from;
+            return to > s.to;
+        };
+    };
+    void computeSavings(int first, int last, std::vector<Saving> &out) const;
+    static int findRoute(std::vector<int> &parent, int nid);
+    double latestFinish(int depotnid, int last, double dep) const;
+    void makeTruck(Vehicle &truck, int depotnid) const;
+
+    // used by giantTour()
+    int buildTour(std::vector<int> &tour);
+    int splitTour(const std::vector<int> &tour, const std::vector<int> &order,
+                  std::vector<int> &cut) const;
+
+    // used by clusterFirst()
+    void assignClusters(std::vector< std::vector<int> > &parts) const;
+    void routeClusters(const std::vector< std::vector<int> > &parts,
+                       std::vector< std::vector<int> > &left,
+                       std::atomic<int> *next);
+    void buildRoute(Vehicle &truck, const std::vector<int> &nids,
+                    std::vector<int> &left) const;
+    double removalGain(const Vehicle &v, int pos) const;
+    int repairBoundaries();
+    int improveRoute(Vehicle &truck, Routeopt &ro) const;
+    int insertUnassigned();
+
+    // used by opt_interRoute()
+    void neighborPairs(
+            std::vector< std::vector< std::pair<int, int> > > &rounds) const;
+    void improvePairs(const std::vector< std::pair<int, int> > &round,
+                      std::atomic<int> *moves, std::atomic<int> *next);
+    struct Scans {
+        int selector;
+        NodeScan nodes;
+        PathScan path;
+    };
+    static const Scans scans[];
+    static const Scans& findScans(int selector);
+
+    template <int S> int scanNodes(const Trashnode &tn, int selector,
+                                   int demandLimit, double *dist);
+    template <int S> int scanPath(const Vehicle &v, int selector,
+                                  int demandLimit, int *pos, double *dist);
+
+    // only instantiated in trashproblem.cpp, NodeFilter applies it there
+    template <int S> bool keepNode(const Trashnode &tn, int i, int selector,
+                                   int demandLimit) const;
+    template <int S> friend class NodeFilter;
 
   public:
     // accessors
     double distance(int nq, int n2) const;
+    Dmatrix::Layout getMatrixLayout() const { return dMatrix.getlayout(); };
 
     bool filterNode(const Trashnode &tn, int i, int selector, int demandLimit);
+    void selectNodes(const Trashnode &tn, int selector, Nodeset &sel) const;
 
     //// these should be const
     int findNearestNodeTo(int nid, int selector, int demandLimit);
@@ -59,7 +182,34 @@ class TrashProblem {
     void loadproblem(std::string& file);
     void setNodeDistances(Trashnode& n);
 
+    // add a node or retire one after loadproblem(), see addNode()
+    int addNode(const Trashnode &node, const double *to=NULL,
+                const double *from=NULL);
+    void retireNode(int nid);
+
+    // select how dMatrix is stored, call before loadproblem()
+    void setMatrixStorage(Dmatrix::Layout layout, Dmatrix::Precision precision,
+                          double scale=0.0) {
+        dMatrix.setstorage(layout, precision, scale);
+    };
+
+    // memory cap for the row cache of a Dmatrix::ONDEMAND matrix
+    void setMatrixCache(size_t bytes) { dMatrix.setcachebytes(bytes); };
+
+    // take the distances from p instead of the coordinates, call before
+    // loadproblem(). Row i of p is the node with nid i. An Mmatrix is used
+    // in place, any other provider is copied into dMatrix.
+    void setDistances(const Distprovider *p) { provider = p; };
+
+    // keep what loadproblem() derives from file in a binary file.cache
+    // next to it and map that on later loads, see loadCache()
+    void setCache(bool _usecache) { usecache = _usecache; };
+
+    // threads for the parallel heuristics, 0 = all cores
+    void setThreads(int _nthreads) { nthreads = _nthreads; };
+
     void buildDistanceMatrix();
+    void buildNeighbors(int k);
 
     // methods to build initial solution
     void clearFleet() { fleet.clear(); };
@@ -67,9 +217,26 @@ class TrashProblem {
     void nearestInsertion();
     void farthestInsertion();
     void assignmentSweep();
+    void segmentInsertion();
+    void clusterFirst();
+    void clarkeWright();
+    void giantTour();
+
+    // start from a previous solution, see warmStart()
+    void loadSolution(const std::string &file);
+    void warmStart(const std::string &text);
 
     // optimization routines
     void opt_2opt();
+    void opt_interRoute();
+
+    // structors
+    TrashProblem() {
+        nthreads = 0;
+        nneighbors = 0;
+        provider = NULL;
+        usecache = false;
+    };
 
 };
 
@@ -1,56 +1,310 @@
 
 
+#include <algorithm>
 #include <iostream>
 
 
 #include "vehicle.h"
 
-void Vehicle::evaluate() {
-    curcapacity = 0;
-    duration = 0;
-    cost = 0;
-    TWV = 0;
-    CV = 0;
+// time we get home if we leave the last stop at t and go by the dump
+double Vehicle::finish(double t, const Trashnode &last, int *ntwv) const {
+    const Trashnode &dump = getdumpsite();
+    const Trashnode &depot = getdepot();
 
-    if (path.size()) {
-        for (int i=0; i<path.size(); i++) {
-            if (i == 0)
-                duration += distancetodepot(i);
-            else
-                duration += path[i].distance(path[i-1]);
+    t += distance(last, dump);
 
-            if (path[i].earlyarrival(duration))
-                duration = path[i].opens();
+    if (dump.earlyarrival(t))
+        t = dump.opens();
 
-            if (path[i].latearrival(duration)) 
-                TWV++;
+    if (dump.latearrival(t))
+        (*ntwv)++;
 
-            duration += path[i].getservicetime();
+    t += dump.getservicetime();
 
-            curcapacity += path[i].getdemand();
-            if (curcapacity > getmaxcapacity())
-                CV++;
-        }
+    t += distance(dump, depot);
+    if (depot.latearrival(t))
+        (*ntwv)++;
+
+    return t;
+}
+
+
+void Vehicle::evaluate(int from) {
+    int n = path.size();
+
+    arrival.resize(n);
+    wait.resize(n);
+    load.resize(n);
+    twv.resize(n);
+    cv.resize(n);
+
+    if (from < 0) from = 0;
+
+    if (!n) {
+        curcapacity = 0;
+        duration = 0;
+        TWV = 0;
+        CV = 0;
+        cost = 0;
+        return;
+    }
 
-        duration += getdumpsite().distance(path.back());
+    for (int i=from; i<n; i++) {
+        double t;
+        int q, nt, nc;
 
-        if (getdumpsite().earlyarrival(duration))
-            duration = getdumpsite().opens();
+        if (i == 0) {
+            t = distance(getdepot(), node(0));
+            q = nt = nc = 0;
+        }
+        else {
+            t = departure(i-1) + distance(node(i-1), node(i));
+            q = load[i-1];
+            nt = twv[i-1];
+            nc = cv[i-1];
+        }
 
-        if (getdumpsite().latearrival(duration))
-            TWV++;
+        arrival[i] = t;
+        wait[i] = node(i).earlyarrival(t) ? node(i).opens() - t : 0.0;
 
-        duration += getdumpsite().getservicetime();
+        if (node(i).latearrival(t + wait[i]))
+            nt++;
 
-        duration += getdumpsite().distance(getdepot());
-        if (getdepot().latearrival(duration))
-            TWV++;
+        q += node(i).getdemand();
+        if (q > getmaxcapacity())
+            nc++;
 
+        load[i] = q;
+        twv[i] = nt;
+        cv[i] = nc;
     }
+
+    curcapacity = load[n-1];
+    TWV = twv[n-1];
+    CV = cv[n-1];
+    duration = finish(departure(n-1), node(n-1), &TWV);
+
     cost = w1*duration + w2*TWV +w3*CV;
 }
 
 
+double Vehicle::testInsert(const Trashnode &n, int pos, double *tduration,
+                           int *tTWV, int *tCV) const {
+    int len = path.size();
+    int maxcap = getmaxcapacity();
+    const Trashnode *prev;
+    double t;
+    int q, nt, nc;
+
+    // start from the state of the stop before pos
+    if (pos == 0) {
+        prev = &getdepot();
+        t = 0;
+        q = nt = nc = 0;
+    }
+    else {
+        prev = &node(pos-1);
+        t = departure(pos-1);
+        q = load[pos-1];
+        nt = twv[pos-1];
+        nc = cv[pos-1];
+    }
+
+    // the new stop
+    t += distance(*prev, n);
+    if (n.earlyarrival(t))
+        t = n.opens();
+    if (n.latearrival(t))
+        nt++;
+    t += n.getservicetime();
+    q += n.getdemand();
+    if (q > maxcap)
+        nc++;
+    prev = &n;
+
+    // the stops that follow it
+    int i;
+    for (i=pos; i<len; i++) {
+        t += distance(*prev, node(i));
+        if (node(i).earlyarrival(t))
+            t = node(i).opens();
+
+        // we start service when we did before so the rest is the same
+        if (t == arrival[i] + wait[i])
+            break;
+
+        if (node(i).latearrival(t))
+            nt++;
+        t += node(i).getservicetime();
+        if (load[i] + n.getdemand() > maxcap)
+            nc++;
+        prev = &node(i);
+    }
+
+    double dur;
+    if (i < len) {
+        nt += TWV - (i ? twv[i-1] : 0);
+        dur = duration;
+        // pickups only add load so the loads are sorted and we can find
+        // the first stop that goes over capacity with the extra demand
+        std::vector<int>::const_iterator it = std::upper_bound(
+                load.begin()+i, load.end(), maxcap - n.getdemand());
+        nc += load.end() - it;
+    }
+    else
+        dur = finish(t, *prev, &nt);
+
+    if (tduration) *tduration = dur;
+    if (tTWV) *tTWV = nt;
+    if (tCV) *tCV = nc;
+
+    return w1*dur + w2*nt + w3*nc;
+}
+
+
+double Vehicle::testReplace(const Trashnode &n, int pos, double *tduration,
+                            int *tTWV, int *tCV) const {
+    int len = path.size();
+    int maxcap = getmaxcapacity();
+    int diff = n.getdemand() - node(pos).getdemand();
+    const Trashnode *prev;
+    double t;
+    int q, nt, nc;
+
+    // start from the state of the stop before pos
+    if (pos == 0) {
+        prev = &getdepot();
+        t = 0;
+        q = nt = nc = 0;
+    }
+    else {
+        prev = &node(pos-1);
+        t = departure(pos-1);
+        q = load[pos-1];
+        nt = twv[pos-1];
+        nc = cv[pos-1];
+    }
+
+    // the new stop
+    t += distance(*prev, n);
+    if (n.earlyarrival(t))
+        t = n.opens();
+    if (n.latearrival(t))
+        nt++;
+    t += n.getservicetime();
+    q += n.getdemand();
+    if (q > maxcap)
+        nc++;
+    prev = &n;
+
+    // the stops that follow it
+    int i;
+    for (i=pos+1; i<len; i++) {
+        t += distance(*prev, node(i));
+        if (node(i).earlyarrival(t))
+            t = node(i).opens();
+
+        // we start service when we did before so the rest is the same
+        if (t == arrival[i] + wait[i])
+            break;
+
+        if (node(i).latearrival(t))
+            nt++;
+        t += node(i).getservicetime();
+        if (load[i] + diff > maxcap)
+            nc++;
+        prev = &node(i);
+    }
+
+    double dur;
+    if (i < len) {
+        nt += TWV - twv[i-1];
+        dur = duration;
+        std::vector<int>::const_iterator it = std::upper_bound(
+                load.begin()+i, load.end(), maxcap - diff);
+        nc += load.end() - it;
+    }
+    else
+        dur = finish(t, *prev, &nt);
+
+    if (tduration) *tduration = dur;
+    if (tTWV) *tTWV = nt;
+    if (tCV) *tCV = nc;
+
+    return w1*dur + w2*nt + w3*nc;
+}
+
+
+double Vehicle::testTail(int pos, const Vehicle &v, int from, double *tduration,
+                         int *tTWV, int *tCV) const {
+    int len = v.size();
+    int maxcap = getmaxcapacity();
+    const Trashnode *prev;
+    double t;
+    int q, nt, nc;
+
+    // nothing is left of either route
+    if (pos == 0 and from >= len) {
+        if (tduration) *tduration = 0;
+        if (tTWV) *tTWV = 0;
+        if (tCV) *tCV = 0;
+        return 0;
+    }
+
+    if (pos == 0) {
+        prev = &getdepot();
+        t = 0;
+        q = nt = nc = 0;
+    }
+    else {
+        prev = &node(pos-1);
+        t = departure(pos-1);
+        q = load[pos-1];
+        nt = twv[pos-1];
+        nc = cv[pos-1];
+    }
+
+    // the load of the tail of v on top of ours
+    int shift = q - (from ? v.load[from-1] : 0);
+
+    int i;
+    for (i=from; i<len; i++) {
+        t += distance(*prev, v.node(i));
+        if (v.node(i).earlyarrival(t))
+            t = v.node(i).opens();
+
+        // from here on the stops are served as they were in v
+        if (t == v.arrival[i] + v.wait[i])
+            break;
+
+        if (v.node(i).latearrival(t))
+            nt++;
+        t += v.node(i).getservicetime();
+        if (v.load[i] + shift > maxcap)
+            nc++;
+        prev = &v.node(i);
+    }
+
+    if (i < len) {
+        nt += v.twv[len-1] - (i ? v.twv[i-1] : 0);
+        std::vector<int>::const_iterator it = std::upper_bound(
+                v.load.begin()+i, v.load.end(), maxcap - shift);
+        nc += v.load.end() - it;
+        t = v.departure(len-1);
+        prev = &v.node(len-1);
+    }
+
+    // but we go to our own dump and home
+    double dur = finish(t, *prev, &nt);
+
+    if (tduration) *tduration = dur;
+    if (tTWV) *tTWV = nt;
+    if (tCV) *tCV = nc;
+
+    return w1*dur + w2*nt + w3*nc;
+}
+
+
 void Vehicle::dump() {
     std::cout << "---------- Vehicle ---------------" << std::endl;
     std::cout << "maxcapacity: " << getmaxcapacity() << std::endl;
@@ -63,6 +317,5 @@ void Vehicle::dump() {
     std::cout << "w2: " << w2 << std::endl;
     std::cout << "w3: " << w3 << std::endl;
     std::cout << "path nodes: -----------------" << std::endl;
-    Twpath::dump();
+    Twpathidx::dump();
 }
-
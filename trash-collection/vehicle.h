@@ -1,14 +1,23 @@
 #ifndef VEHICLE_H
 #define VEHICLE_H
 
-#include "twpath.h"
+#include <vector>
+
+#include "dmatrix.h"
+#include "twpathidx.h"
 #include "trashnode.h"
 
 // TODO: change curcapacity to curload
 //       add getcurload() and change getcurcapacity(0 to return
 //       getmaxcapacity()-curload
 
-class Vehicle : public Twpath<Trashnode> {
+// The vehicle keeps the state of the route at every stop (arrival time,
+// wait, load and the violations so far) so that after a stop is added or
+// inserted at pos only the stops from pos onward have to be evaluated
+// again. The same state lets testInsert() answer "what would the route
+// cost with n at pos" without changing the path.
+
+class Vehicle : public Twpathidx<Trashnode> {
   private:
     int curcapacity;    // current USED capacity of the vehicle
     double duration;    // duration of the route
@@ -20,6 +29,20 @@ class Vehicle : public Twpath<Trashnode> {
     double w2;          // weight for TWV in cost
     double w3;          // weight for CV in cost
 
+    const Dmatrix *dm;  // distances between nids, NULL to use Node::distance
+
+    // state of the route at each stop in path
+    std::vector<double> arrival;    // time we arrive at the stop
+    std::vector<double> wait;       // time waiting for the window to open
+    std::vector<int> load;          // load after servicing the stop
+    std::vector<int> twv;           // TW violations up to the stop
+    std::vector<int> cv;            // capacity violations up to the stop
+
+    double departure(int i) const {
+        return arrival[i] + wait[i] + node(i).getservicetime();
+    };
+    double finish(double t, const Trashnode &last, int *ntwv) const;
+
   public:
 
     // structors
@@ -32,10 +55,22 @@ class Vehicle : public Twpath<Trashnode> {
         TWV         = 0;
         CV          = 0;
         w1 = w2 = w3 = 1.0;
+        dm = NULL;
+    };
+
+    // the path holds indices into nodes, see Twpathidx
+    Vehicle(const std::vector<Trashnode> &_nodes) : Twpathidx<Trashnode>(_nodes) {
+        curcapacity = 0;
+        duration    = 0;
+        cost        = 0;
+        TWV         = 0;
+        CV          = 0;
+        w1 = w2 = w3 = 1.0;
+        dm = NULL;
     };
 
     // accessors
-    int getmaxcapacity() {              //// should be const
+    int getmaxcapacity() const {
         return getdepot().getdemand();
     };
     int getTWV() const { return TWV; };
@@ -47,9 +82,29 @@ class Vehicle : public Twpath<Trashnode> {
     double getw2() const { return w2; };
     double getw3() const { return w3; };
 
-    // these should be const
-    double distancetodepot(int i) { return path[i].distance(getdepot()); };
-    double distancetodump(int i) { return path[i].distance(getdumpsite()); };
+    // per stop state, valid after evaluate()
+    double getarrival(int i) const { return arrival[i]; };
+    double getwait(int i) const { return wait[i]; };
+    int getload(int i) const { return load[i]; };
+
+    double distance(const Trashnode &a, const Trashnode &b) const {
+        return dm ? dm->get(a.getnid(), b.getnid()) : a.distance(b);
+    };
+    double distancetodepot(int i) const { return distance(node(i), getdepot()); };
+    double distancetodump(int i) const { return distance(node(i), getdumpsite()); };
+
+    // cost of the route if n was inserted at pos, the path is not changed
+    double testInsert(const Trashnode &n, int pos, double *tduration=NULL,
+                      int *tTWV=NULL, int *tCV=NULL) const;
+
+    // the same if the stop at pos was replaced by n
+    double testReplace(const Trashnode &n, int pos, double *tduration=NULL,
+                       int *tTWV=NULL, int *tCV=NULL) const;
+
+    // the same if the stops from pos on were replaced by the stops of v
+    // from from on, the route keeps its own depot and dump
+    double testTail(int pos, const Vehicle &v, int from, double *tduration=NULL,
+                    int *tTWV=NULL, int *tCV=NULL) const;
 
     void dump();
 
@@ -59,8 +114,36 @@ class Vehicle : public Twpath<Trashnode> {
         w2 = _w2;
         w3 = _w3;
     };
+    void setdmatrix(const Dmatrix *_dm) { dm = _dm; };
+
+    // these keep the evaluation up to date
+    void push_back(const Trashnode &n) {
+        path.push_back(n.getnid());
+        evaluate(path.size()-1);
+    };
+    void push_front(const Trashnode &n) {
+        path.push_front(n.getnid());
+        evaluate(0);
+    };
+    iterator insert(iterator it, const Trashnode &n) {
+        int pos = it - path.begin();
+        it = path.insert(it, n.getnid());
+        evaluate(pos);
+        return it;
+    };
+    iterator erase(iterator it) {
+        int pos = it - path.begin();
+        it = path.erase(it);
+        evaluate(pos);
+        return it;
+    };
+    void clear() {
+        path.clear();
+        evaluate();
+    };
 
-    void evaluate();
+    void evaluate() { evaluate(0); };
+    void evaluate(int from);
 
 };
 
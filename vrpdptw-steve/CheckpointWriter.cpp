@@ -0,0 +1,78 @@
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CheckpointWriter.h"
+
+
+CheckpointWriter::CheckpointWriter(const std::string &_file) : file(_file) {
+    havePending = false;
+    done = false;
+    worker = std::thread(&CheckpointWriter::run, this);
+}
+
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+
+// take over data, it is left empty
+void CheckpointWriter::post(std::string &data) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending.swap(data);
+        havePending = true;
+    }
+    data.clear();
+    wake.notify_one();
+}
+
+
+void CheckpointWriter::run() {
+    std::string data;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return havePending or done; });
+            if (!havePending) break;
+            data.swap(pending);
+            havePending = false;
+        }
+        write(data);
+    }
+}
+
+
+// a failed write only costs this checkpoint, the search goes on
+void CheckpointWriter::write(const std::string &data) {
+    std::string tmp = file + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd != -1;
+
+    size_t written = 0;
+    while (ok and written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n == -1 and errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) written += n;
+    }
+    ok = ok and fsync(fd) == 0;
+    if (fd != -1 and ::close(fd) == -1) ok = false;
+
+    if (ok and !std::rename(tmp.c_str(), file.c_str()))
+        return;
+
+    std::remove(tmp.c_str());
+    std::cerr << "WARNING: CheckpointWriter::write - can not write '"
+              << file << "'" << std::endl;
+}
@@ -0,0 +1,43 @@
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// CheckpointWriter writes snapshots of a search to a file on a thread of
+// its own, so the search only pays for building the snapshot in memory.
+// post() hands over a snapshot and returns at once, when the writer is
+// still busy with an older one only the newest is kept. Each snapshot is
+// written to file.tmp, synced and renamed over file, a job or host that
+// dies in the middle of a write leaves the previous checkpoint intact.
+// The destructor writes what is still pending and joins the thread.
+
+class CheckpointWriter {
+  public:
+    std::string file;
+
+    CheckpointWriter(const std::string &_file);
+
+    ~CheckpointWriter();
+
+    void post(std::string &data);
+
+  private:
+    std::string pending;
+    bool havePending;
+    bool done;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread worker;
+
+    void run();
+
+    void write(const std::string &data);
+
+    CheckpointWriter(const CheckpointWriter &);
+    CheckpointWriter &operator=(const CheckpointWriter &);
+};
+
+#endif
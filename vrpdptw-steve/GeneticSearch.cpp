@@ -0,0 +1,307 @@
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "GeneticSearch.h"
+#include "TabuSearch.h"
+
+
+Solution GeneticSearch::solve() {
+    started = std::chrono::steady_clock::now();
+    pop.clear();
+    made = 0;
+
+    // the construction we were given and random orders of it
+    std::vector<int> seq;
+    chromosome(Best, seq);
+    addIndividual(Best);
+
+    std::mt19937 rng(seed);
+    for (int i=1; i<popSize and !timeUp(); i++) {
+        std::shuffle(seq.begin(), seq.end(), rng);
+        Solution s(P);
+        decode(seq, s);
+        educate(s);
+        addIndividual(s);
+    }
+    updateFitness();
+
+    if (verbose)
+        std::cout << "GeneticSearch: population: " << pop.size()
+                  << ", best: " << BestCost << std::endl;
+
+    return evolve(maxIter);
+}
+
+
+// Make up to children more children from the population solve() left,
+// with what was added by addIndividual() since. The children are numbered
+// on from the last call, so they get other random generators.
+Solution GeneticSearch::resume(int children) {
+    if (pop.empty()) {
+        std::string errmsg = "GeneticSearch::resume - there is no population, call solve() first.";
+        throw std::runtime_error(errmsg);
+    }
+    started = std::chrono::steady_clock::now();
+    updateFitness();
+    return evolve(children);
+}
+
+
+// maxTime is checked between the individuals and the batches, a batch
+// that was started is finished
+bool GeneticSearch::timeUp() const {
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - started;
+    return maxTime > 0.0 and t.count() >= maxTime;
+}
+
+
+// breed batches of children until children were made, maxNoImprove of
+// them in a row did not improve Best or the time is up
+Solution GeneticSearch::evolve(int children) {
+    int nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+    if (nt < 1) nt = 1;
+
+    // a batch per thread, but never more than fit before a selection
+    int batch = std::min(std::max(nt, 4), generation);
+
+    int last = made + children;
+    int lastImprove = made;
+    while (made < last and made - lastImprove < maxNoImprove
+           and !timeUp()) {
+        std::vector<Solution> kids(batch, Solution(P));
+
+        std::atomic<int> counter(0);
+        std::vector<std::thread> workers;
+        for (int t=1; t<nt and t<batch; t++)
+            workers.push_back(std::thread(&GeneticSearch::breed, this,
+                              std::ref(kids), made, &counter));
+        breed(kids, made, &counter);
+        for (int t=0; t<workers.size(); t++)
+            workers[t].join();
+
+        for (int i=0; i<batch; i++) {
+            double before = BestCost;
+            addIndividual(kids[i]);
+            if (BestCost < before) {
+                lastImprove = made + i;
+                if (verbose)
+                    std::cout << "GeneticSearch: child: " << made + i
+                              << ", best: " << BestCost << std::endl;
+            }
+        }
+        made += batch;
+
+        if (pop.size() >= popSize + generation)
+            selectSurvivors();
+        else
+            updateFitness();
+    }
+
+    if (verbose)
+        std::cout << "GeneticSearch: children: " << made
+                  << ", best: " << BestCost << std::endl;
+
+    return Best;
+}
+
+
+// the orders along the routes in the order of their pickups
+void GeneticSearch::chromosome(const Solution &s, std::vector<int> &seq) const {
+    seq.clear();
+    for (int i=0; i<s.R.size(); i++) {
+        const Route &r(s.R[i]);
+        for (int j=0; j<r.path.size(); j++)
+            if (P.O[r.orders[j]].pid == r.path[j])
+                seq.push_back(r.orders[j]);
+    }
+}
+
+
+// insert the orders in sequence at their cheapest feasible place, an
+// order that fits nowhere starts a new route
+void GeneticSearch::decode(const std::vector<int> &seq, Solution &s) const {
+    s.R.clear();
+    s.mapOtoR.assign(P.O.size(), -1);
+
+    for (int i=0; i<seq.size(); i++)
+        s.insertOrder(seq[i]);
+
+    s.computeCosts();
+}
+
+
+// order crossover: a slice of a is kept in place and the rest is filled
+// with the orders of b in the order they come after the slice
+void GeneticSearch::crossover(const std::vector<int> &a,
+                              const std::vector<int> &b,
+                              std::mt19937 &rng,
+                              std::vector<int> &child) const {
+    int n = a.size();
+    child.assign(n, -1);
+    if (!n) return;
+
+    std::uniform_int_distribution<int> pick(0, n-1);
+    int from = pick(rng);
+    int to = pick(rng);
+    if (from > to) std::swap(from, to);
+
+    std::vector<char> used(P.O.size(), 0);
+    for (int i=from; i<=to; i++) {
+        child[i] = a[i];
+        used[a[i]] = 1;
+    }
+
+    int k = (to + 1) % n;
+    for (int i=0; i<n; i++) {
+        int oid = b[(to + 1 + i) % n];
+        if (used[oid]) continue;
+        child[k] = oid;
+        k = (k + 1) % n;
+    }
+}
+
+
+// a short tabu search, s becomes the best solution it found
+void GeneticSearch::educate(Solution &s) const {
+    s.computeCosts();
+    TabuSearch TS(s);
+    TS.verbose = false;
+    TS.resume(eduIter);
+    s = TS.Best;
+    s.computeCosts();
+}
+
+
+// binary tournament on the biased fitness
+int GeneticSearch::tournament(std::mt19937 &rng) const {
+    std::uniform_int_distribution<int> pick(0, pop.size()-1);
+    int a = pick(rng);
+    int b = pick(rng);
+    return pop[a].fitness <= pop[b].fitness ? a : b;
+}
+
+
+// worker for solve(), takes children off *next until the batch is done
+void GeneticSearch::breed(std::vector<Solution> &children, int first,
+                          std::atomic<int> *next) const {
+    std::vector<int> a, b, child;
+
+    while (true) {
+        int i = next->fetch_add(1);
+        if (i >= children.size()) break;
+
+        std::mt19937 rng(seed + 7919 * (first + i + 1));
+        int pa = tournament(rng);
+        int pb = tournament(rng);
+        chromosome(pop[pa].S, a);
+        chromosome(pop[pb].S, b);
+        crossover(a, b, rng, child);
+
+        decode(child, children[i]);
+        educate(children[i]);
+    }
+}
+
+
+// share of the orders that are followed by another order than in b
+double GeneticSearch::brokenPairs(const Individual &a, const Individual &b) const {
+    int n = 0;
+    int broken = 0;
+    for (int oid=1; oid<a.succ.size(); oid++) {
+        if (a.succ[oid] == -1) continue;
+        n++;
+        if (a.succ[oid] != b.succ[oid]) broken++;
+    }
+    return n ? (double) broken / n : 0.0;
+}
+
+
+void GeneticSearch::addIndividual(const Solution &s) {
+    Individual ind(s);
+    ind.S.computeCosts();
+    ind.cost = ind.S.getCost();
+
+    ind.succ.assign(P.O.size(), -1);
+    for (int i=0; i<ind.S.R.size(); i++) {
+        const Route &r(ind.S.R[i]);
+        int last = -1;
+        for (int j=0; j<r.path.size(); j++) {
+            int oid = r.orders[j];
+            if (P.O[oid].pid != r.path[j]) continue;
+            if (last != -1) ind.succ[last] = oid;
+            last = oid;
+        }
+        if (last != -1) ind.succ[last] = 0;
+    }
+
+    pop.push_back(ind);
+
+    if (ind.cost < BestCost) {
+        Best = ind.S;
+        BestCost = ind.cost;
+    }
+}
+
+
+// rank by cost plus the weighted rank by diversity, see the header
+void GeneticSearch::updateFitness() {
+    int n = pop.size();
+    if (n < 2) {
+        if (n) pop[0].fitness = 0.0;
+        return;
+    }
+
+    std::vector< std::pair<double, int> > bycost(n);
+    std::vector< std::pair<double, int> > bydiv(n);
+    std::vector<double> d;
+    for (int i=0; i<n; i++) {
+        d.clear();
+        for (int j=0; j<n; j++)
+            if (j != i) d.push_back(brokenPairs(pop[i], pop[j]));
+        int k = std::min(nClose, (int) d.size());
+        std::partial_sort(d.begin(), d.begin()+k, d.end());
+        double avg = 0.0;
+        for (int j=0; j<k; j++) avg += d[j];
+
+        bycost[i] = std::make_pair(pop[i].cost, i);
+        // more diverse ranks first
+        bydiv[i] = std::make_pair(-avg / k, i);
+    }
+    std::sort(bycost.begin(), bycost.end());
+    std::sort(bydiv.begin(), bydiv.end());
+
+    double weight = 1.0 - (double) std::min(nElite, n) / n;
+    for (int r=0; r<n; r++)
+        pop[bycost[r].second].fitness = (double) r / (n-1);
+    for (int r=0; r<n; r++)
+        pop[bydiv[r].second].fitness += weight * r / (n-1);
+}
+
+
+// drop clones and then the worst individuals until popSize are left
+void GeneticSearch::selectSurvivors() {
+    while (pop.size() > popSize) {
+        updateFitness();
+
+        int worst = -1;
+        for (int i=0; i<pop.size() and worst == -1; i++)
+            for (int j=0; j<pop.size(); j++)
+                if (i != j and pop[i].cost >= pop[j].cost
+                        and brokenPairs(pop[i], pop[j]) == 0.0) {
+                    worst = i;
+                    break;
+                }
+
+        if (worst == -1) {
+            worst = 0;
+            for (int i=1; i<pop.size(); i++)
+                if (pop[i].fitness > pop[worst].fitness) worst = i;
+        }
+
+        pop.erase(pop.begin() + worst);
+    }
+    updateFitness();
+}
@@ -0,0 +1,121 @@
+#ifndef GENETICSEARCH_H
+#define GENETICSEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Problem.h"
+#include "Solution.h"
+
+// GeneticSearch is a hybrid genetic search on top of the tabu search.
+//
+// An individual is a Solution, its chromosome is the sequence of the
+// orders along its routes in pickup order. A child is made with an order
+// crossover (OX) of the chromosomes of two parents picked by binary
+// tournament, then decoded into routes by inserting the orders one by one
+// at their cheapest feasible place with Route::insertOrder(), starting a
+// new route when an order fits nowhere, and then educated with a short
+// TabuSearch run (SPI, SBR, WRI).
+//
+// The population is ranked by a biased fitness that adds the rank of each
+// individual's cost and the rank of its diversity, the average broken
+// pairs distance to its nClose closest individuals, so the search keeps
+// solutions that are different even when they are worse. When the
+// population reaches popSize + generation, clones and then the worst
+// individuals are removed until popSize are left.
+//
+// The children of a batch only read the population, so they are made and
+// educated by worker threads. Each child gets its own random generator
+// seeded from its number, the result does not depend on the threads.
+//
+// resume() breeds more children from the population solve() left, after
+// addIndividual() has put solutions found elsewhere into it.
+
+class GeneticSearch {
+  public:
+    struct Individual {
+        Solution S;
+        double cost;
+        std::vector<int> succ;  // next order on the route, 0 at the end
+        double fitness;         // biased fitness, lower is better
+
+        Individual(const Solution &s) : S(s) {
+            cost = 0.0;
+            fitness = 0.0;
+        };
+    };
+
+    Problem& P;
+
+    std::vector<Individual> pop;
+    Solution Best;
+    double BestCost;
+
+    int popSize;        // individuals kept after a survivor selection
+    int generation;     // children added before the next selection
+    int nElite;         // individuals protected by the fitness bias
+    int nClose;         // neighbors used for the diversity
+    int maxIter;        // children to make in total
+    int maxNoImprove;   // stop after this many children without a new best
+    int eduIter;        // tabu search iterations to educate a child
+    int nthreads;       // threads to make the children, 0 = all cores
+    double maxTime;     // seconds solve() or resume() may run, 0 = no limit
+    unsigned int seed;
+    bool verbose;       // report the population and new bests on std::cout
+
+    int made;           // children made so far
+    std::chrono::steady_clock::time_point started;
+
+    GeneticSearch(Solution &s) : P(s.P), Best(s) {
+        Best.computeCosts();
+        BestCost = Best.getCost();
+        popSize = 25;
+        generation = 40;
+        nElite = 4;
+        nClose = 5;
+        maxIter = 2000;
+        maxNoImprove = 500;
+        eduIter = 25;
+        nthreads = 0;
+        maxTime = 0.0;
+        seed = 1;
+        verbose = true;
+        made = 0;
+    };
+
+    Solution solve();
+
+    Solution resume(int children);
+
+    Solution evolve(int children);
+
+    bool timeUp() const;
+
+    void chromosome(const Solution &s, std::vector<int> &seq) const;
+
+    void decode(const std::vector<int> &seq, Solution &s) const;
+
+    void crossover(const std::vector<int> &a, const std::vector<int> &b,
+                   std::mt19937 &rng, std::vector<int> &child) const;
+
+    void educate(Solution &s) const;
+
+    int tournament(std::mt19937 &rng) const;
+
+    void breed(std::vector<Solution> &children, int first,
+               std::atomic<int> *next) const;
+
+    double brokenPairs(const Individual &a, const Individual &b) const;
+
+    void addIndividual(const Solution &s);
+
+    void updateFitness();
+
+    void selectSurvivors();
+
+};
+
+#endif
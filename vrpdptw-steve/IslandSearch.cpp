@@ -0,0 +1,279 @@
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "IslandSearch.h"
+#include "GeneticSearch.h"
+#include "TabuSearch.h"
+
+const size_t RINGALIGN = 64;
+
+
+Solution IslandSearch::solve() {
+    int n = nislands > 0 ? nislands : std::thread::hardware_concurrency();
+    if (n < 1) n = 1;
+
+    openRing(2 * n);
+
+    // what is buffered would be written again by every island
+    std::cout.flush();
+
+    std::vector<pid_t> pids;
+    for (int i=0; i<n; i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            std::cout << "WARNING: IslandSearch::solve - fork failed for island "
+                      << i << std::endl;
+            break;
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                island(i);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "IslandSearch: island " << i << ": "
+                          << e.what() << std::endl;
+                status = 1;
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+        pids.push_back(pid);
+    }
+
+    for (int i=0; i<pids.size(); i++) {
+        int status;
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) or WEXITSTATUS(status))
+            std::cout << "IslandSearch: island " << i
+                      << " failed, status: " << status << std::endl;
+    }
+
+    // the best solution any island published
+    Solution s(P);
+    if (fetch(-1, s) and s.getCost() < BestCost) {
+        Best = s;
+        BestCost = s.getCost();
+    }
+
+    if (verbose)
+        std::cout << "IslandSearch: islands: " << pids.size()
+                  << ", published: " << head->load()
+                  << ", best: " << BestCost << std::endl;
+
+    closeRing();
+    return Best;
+}
+
+
+// the search of island i, this runs in its own process
+void IslandSearch::island(int i) {
+    Solution cur(Best);
+
+    // every island but the first starts from its own random order
+    if (i) {
+        GeneticSearch G(cur);
+        std::vector<int> seq;
+        G.chromosome(cur, seq);
+        std::mt19937 rng(seed + 7919 * i);
+        std::shuffle(seq.begin(), seq.end(), rng);
+        G.decode(seq, cur);
+    }
+
+    // an island keeps its search through all the epochs, a genetic one
+    // keeps its population and takes the migrants into it
+    bool genetic = i % 2;
+    TabuSearch TS(cur);
+    TS.verbose = false;
+    GeneticSearch G(cur);
+    G.maxIter = interval;
+    G.nthreads = 1;
+    G.seed = seed + 7919 * i;
+    G.verbose = false;      // the islands report their migrations
+
+    for (int e=0; e<epochs; e++) {
+        if (genetic)
+            cur = e ? G.resume(interval) : G.solve();
+        else {
+            TS.resume(interval);
+            cur = TS.Best;
+        }
+        cur.computeCosts();
+        publish(i, cur);
+
+        Solution elite(P);
+        if (fetch(i, elite) and elite.getCost() < cur.getCost()) {
+            if (verbose)
+                std::cout << "IslandSearch: island " << i << ", epoch " << e
+                          << ": migrate " << cur.getCost() << " -> "
+                          << elite.getCost() << std::endl;
+            cur = elite;
+            if (genetic)
+                G.addIndividual(elite);
+            else {
+                TS.S = cur;
+                TS.restart();
+            }
+        }
+    }
+}
+
+
+// map the header and nslots slots, shared with the processes forked later
+void IslandSearch::openRing(int _nslots) {
+    closeRing();
+
+    // a route list has at most a count, one length per order and the nodes
+    nslots = _nslots;
+    slotints = 1 + P.O.size() + P.N.size();
+
+    // each slot on its own cache lines
+    slotbytes = sizeof(Slot) + slotints * sizeof(int);
+    slotbytes = (slotbytes + RINGALIGN - 1) / RINGALIGN * RINGALIGN;
+    ringbytes = RINGALIGN + (size_t) nslots * slotbytes;
+
+    ring = mmap(NULL, ringbytes, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        ring = NULL;
+        std::string errmsg = "IslandSearch::openRing - can not map the ring.";
+        throw std::runtime_error(errmsg);
+    }
+
+    // the mapping starts out zeroed, only the islands need to be set
+    head = new (ring) std::atomic<uint32_t>(0);
+    for (int k=0; k<nslots; k++) {
+        Slot *s = new (slot(k)) Slot;
+        s->version.store(0);
+        s->island = -1;
+        s->cost = 0.0;
+        s->nints = 0;
+    }
+}
+
+
+void IslandSearch::closeRing() {
+    if (ring) munmap(ring, ringbytes);
+    ring = NULL;
+    head = NULL;
+}
+
+
+// the head counter has the first RINGALIGN bytes to itself
+IslandSearch::Slot* IslandSearch::slot(int k) const {
+    return (Slot *) ((char *) ring + RINGALIGN + k * slotbytes);
+}
+
+
+int* IslandSearch::slotdata(int k) const {
+    return (int *) (slot(k) + 1);
+}
+
+
+// write s into the next slot of the ring
+void IslandSearch::publish(int i, const Solution &s) {
+    int k = head->fetch_add(1) % nslots;
+    Slot *sl = slot(k);
+
+    uint32_t v = sl->version.load();
+    // another island is still writing this slot, leave it to them
+    if (v & 1 or !sl->version.compare_exchange_strong(v, v + 1))
+        return;
+
+    sl->island = i;
+    sl->cost = s.totalCost;
+    sl->nints = encode(s, slotdata(k));
+    sl->version.store(v + 2, std::memory_order_release);
+}
+
+
+// the best solution in the ring not published by island i, -1 for any
+bool IslandSearch::fetch(int i, Solution &s) const {
+    std::vector<int> data(slotints);
+    int best = -1;
+    double bestCost = 0.0;
+    int bestInts = 0;
+    std::vector<int> bestData;
+
+    for (int k=0; k<nslots; k++) {
+        Slot *sl = slot(k);
+        uint32_t v = sl->version.load(std::memory_order_acquire);
+        if (v == 0 or v & 1) continue;
+
+        int island = sl->island;
+        double cost = sl->cost;
+        int nints = sl->nints;
+        if (island == i or (best != -1 and cost >= bestCost)) continue;
+        if (nints < 0 or nints > slotints) continue;
+        memcpy(&data[0], slotdata(k), nints * sizeof(int));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sl->version.load(std::memory_order_relaxed) != v) continue;
+
+        best = k;
+        bestCost = cost;
+        bestInts = nints;
+        bestData.swap(data);
+        data.resize(slotints);
+    }
+
+    if (best == -1) return false;
+    decode(&bestData[0], bestInts, s);
+    return true;
+}
+
+
+// nroutes, then the length and the node ids of each route
+int IslandSearch::encode(const Solution &s, int *data) const {
+    int n = 0;
+    data[n++] = 0;
+    for (int i=0; i<s.R.size(); i++) {
+        const Route &r(s.R[i]);
+        if (!r.path.size()) continue;
+        data[0]++;
+        data[n++] = r.path.size();
+        for (int j=0; j<r.path.size(); j++)
+            data[n++] = r.path[j];
+    }
+    return n;
+}
+
+
+void IslandSearch::decode(const int *data, int nints, Solution &s) const {
+    // the order of each node
+    std::vector<int> oidOf(P.N.size(), 0);
+    for (int oid=1; oid<P.O.size(); oid++) {
+        oidOf[P.O[oid].pid] = oid;
+        oidOf[P.O[oid].did] = oid;
+    }
+
+    s.R.clear();
+    s.mapOtoR.assign(P.O.size(), -1);
+
+    int n = 1;
+    for (int i=0; i<data[0] and n<nints; i++) {
+        Route r(P);
+        r.rid = s.R.size();
+        int len = data[n++];
+        for (int j=0; j<len; j++) {
+            int nid = data[n++];
+            r.path.push_back(nid);
+            r.orders.push_back(oidOf[nid]);
+            s.mapOtoR[oidOf[nid]] = r.rid;
+        }
+        r.updated = true;
+        s.R.push_back(r);
+    }
+    s.computeCosts();
+}
@@ -0,0 +1,101 @@
+#ifndef ISLANDSEARCH_H
+#define ISLANDSEARCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#include "Problem.h"
+#include "Solution.h"
+
+// IslandSearch spreads one solve over several processes on the same host.
+// Each island is a forked process that runs its own search, the even ones
+// a TabuSearch and the odd ones a GeneticSearch, all but the first from a
+// random start. After every epoch of interval iterations (children for
+// the genetic islands) an island publishes its best solution to a ring
+// in shared memory and continues from the best solution another island
+// published, if that is better than its own.
+//
+// The ring is mapped before the fork so all the islands see it. Each slot
+// holds one solution as a list of routes of node ids and is guarded by a
+// version counter: the writer makes it odd while it writes, a reader that
+// sees it odd or changed after copying the slot just skips it.
+//
+// The islands only share the ring. The problem, and a matrix file mapped
+// by Mmatrix, are shared read only through the fork, and an island that
+// crashes only loses its own search, the others keep publishing.
+
+class IslandSearch {
+  public:
+    struct Slot {
+        std::atomic<uint32_t> version;  // odd while it is written
+        int island;                     // who published it, -1 if empty
+        double cost;
+        int nints;                      // ints used in data
+    };
+
+    Problem& P;
+
+    Solution Best;
+    double BestCost;
+
+    int nislands;       // processes to fork, 0 = all cores
+    int epochs;         // exchanges between the islands
+    int interval;       // tabu iterations or genetic children per epoch
+    unsigned int seed;
+    bool verbose;       // report the migrations and the result on std::cout
+
+    // the ring in shared memory
+    void *ring;
+    size_t ringbytes;
+    int nslots;
+    int slotints;       // ints of route data per slot
+    size_t slotbytes;   // distance between the slots
+    std::atomic<uint32_t> *head;    // slots written so far
+
+    IslandSearch(Solution &s) : P(s.P), Best(s) {
+        Best.computeCosts();
+        BestCost = Best.getCost();
+        nislands = 0;
+        epochs = 10;
+        interval = 50;
+        seed = 1;
+        verbose = true;
+        ring = NULL;
+        ringbytes = 0;
+        nslots = 0;
+        slotints = 0;
+        slotbytes = 0;
+        head = NULL;
+    };
+
+    ~IslandSearch() { closeRing(); };
+
+    Solution solve();
+
+    void island(int i);
+
+    void openRing(int _nslots);
+
+    void closeRing();
+
+    Slot* slot(int k) const;
+
+    int* slotdata(int k) const;
+
+    void publish(int i, const Solution &s);
+
+    bool fetch(int i, Solution &s) const;
+
+    int encode(const Solution &s, int *data) const;
+
+    void decode(const int *data, int nints, Solution &s) const;
+
+  private:
+    IslandSearch(const IslandSearch &);
+    IslandSearch &operator=(const IslandSearch &);
+
+};
+
+#endif
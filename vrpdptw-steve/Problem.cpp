@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <math.h>
 
+#include "cachefile.h"
+#include "tokenizer.h"
 #include "Problem.h"
 
 // NON class functions for sorting
@@ -23,6 +25,7 @@ unsigned int Problem::getOrderCount() {
 }
 
 double Problem::distance(int n1, int n2) const {
+    if (dp) return dp->distance(n1, n2);
     double dx = N[n2].x - N[n1].x;
     double dy = N[n2].y - N[n1].y;
     return sqrt( dx*dx + dy*dy );
@@ -51,14 +54,116 @@ void Problem::dump() {
 
 void Problem::loadProblem(char *infile)
 {
-    std::ifstream in( infile );
-    std::string line;
+    // the orders hold distances, the cache only has euclidean ones
+    bool cached = usecache and !dp;
+    uint64_t key = 0;
+    std::string cachefile = std::string(infile) + ".cache";
+    if (cached) {
+        key = Cachefile::hash(infile);
+        if (loadCache(cachefile, key))
+            return;
+    }
+
+    Tokenizer tk( infile );
 
     // read header line
-    std::getline(in, line);
-    std::istringstream buffer( line );
-    buffer >> K;
-    buffer >> Q;
+    if (!tk.nextline()) {
+        std::string errmsg = "Problem::loadProblem - '" + tk.getname() + "' is empty.";
+        throw std::runtime_error(errmsg);
+    }
+    tk >> K >> Q;
+
+    // read the nodes
+    while ( tk.nextline() ) {
+        Node node;
+        tk >> node.nid >> node.x >> node.y >> node.demand
+           >> node.tw_open >> node.tw_close >> node.service
+           >> node.pid >> node.did;
+        N.push_back(node);
+    }
+
+    prepare();
+
+    if (cached) {
+        try {
+            saveCache(cachefile, key);
+        }
+        catch (const std::exception &e) {
+            std::cout << "WARNING: " << e.what() << std::endl;
+        }
+    }
+}
+
+
+// Load the nodes from arrays of n values, node i is N[i] and must have
+// nid i. This is what the C interface uses, see vrpdptw_c.h. The arrays
+// come from the caller and not from a file we wrote, so the depot, the
+// node ranges and the pickup/delivery pairs are checked before anything
+// is derived from them.
+void Problem::loadArrays(int _K, int _Q, int n, const int *nid,
+                         const double *x, const double *y, const int *demand,
+                         const int *tw_open, const int *tw_close,
+                         const int *service, const int *pid, const int *did)
+{
+    K = _K;
+    Q = _Q;
+    N.clear();
+    O.clear();
+
+    N.resize(n);
+    for (int i=0; i<n; i++) {
+        if (nid[i] != i) {
+            std::string errmsg = "Problem::loadArrays - node ids must be 0..n-1 in order.";
+            throw std::runtime_error(errmsg);
+        }
+        N[i].nid = nid[i];
+        N[i].x = x[i];
+        N[i].y = y[i];
+        N[i].demand = demand[i];
+        N[i].tw_open = tw_open[i];
+        N[i].tw_close = tw_close[i];
+        N[i].service = service[i];
+        N[i].pid = pid[i];
+        N[i].did = did[i];
+    }
+
+    if (n < 3) {
+        std::string errmsg = "Problem::loadArrays - need the depot and at least one order.";
+        throw std::runtime_error(errmsg);
+    }
+    if (N[0].pid != 0 or N[0].did != 0) {
+        std::string errmsg = "Problem::loadArrays - node 0 must be the depot with pid and did 0.";
+        throw std::runtime_error(errmsg);
+    }
+    for (int i=1; i<n; i++) {
+        int p = N[i].pid;
+        int d = N[i].did;
+        if (p < 0 or p >= n or d < 0 or d >= n) {
+            std::string errmsg = "Problem::loadArrays - pid or did out of range at node " + std::to_string(i) + ".";
+            throw std::runtime_error(errmsg);
+        }
+        // a pickup names its delivery and that delivery names it back
+        bool paired = (p == 0) ? (d != 0 and N[d].pid == i and N[d].did == 0)
+                               : (d == 0 and N[p].did == i and N[p].pid == 0);
+        if (!paired) {
+            std::string errmsg = "Problem::loadArrays - node " + std::to_string(i) + " is not half of a pickup and delivery pair.";
+            throw std::runtime_error(errmsg);
+        }
+    }
+
+    prepare();
+}
+
+
+// everything that is derived from the nodes: the plot extents, the
+// depot close time, the sorted orders and the average window length
+void Problem::prepare()
+{
+    // a larger provider leaves room for orders added later
+    if (dp && dp->size() < N.size()) {
+        std::string errmsg = "Problem::prepare - the distances do not cover the nodes.";
+        throw std::runtime_error(errmsg);
+    }
 
     // initialize the extents
     extents[0] = std::numeric_limits<double>::max();
@@ -66,33 +171,18 @@ void Problem::loadProblem(char *infile)
     extents[2] = std::numeric_limits<double>::min();
     extents[3] = std::numeric_limits<double>::min();
 
+    for (int i=0; i<N.size(); i++) {
+        const Node &node(N[i]);
 
-    // read the nodes
-    while ( getline(in, line) ) {
-        Node node;
-        std::istringstream buffer( line );
-        buffer >> node.nid;
-        buffer >> node.x;
-        buffer >> node.y;
-        buffer >> node.demand;
-        buffer >> node.tw_open;
-        buffer >> node.tw_close;
-        buffer >> node.service;
-        buffer >> node.pid;
-        buffer >> node.did;
-
-        // compute the extents as we load the data for plotting
+        // compute the extents for plotting
         if (node.x < extents[0]) extents[0] = node.x;
         if (node.y < extents[1]) extents[1] = node.y;
         if (node.x > extents[2]) extents[2] = node.x;
         if (node.y > extents[3]) extents[3] = node.y;
 
-        N.push_back(node);
-
         if (node.nid == 0)
             DepotClose = node.tw_close;
     }
-    in.close();
 
     // add a small buffer around the extents
     extents[0] -= (extents[2] - extents[0]) * 0.02;
@@ -110,6 +200,148 @@ void Problem::loadProblem(char *infile)
 }
 
 
+// sections of the cache, nodes and orders are kept as one array per field
+enum CacheSection {
+    CACHE_HEADER = 1,           // K, Q, DepotClose
+    CACHE_STATS,                // atwl, extents[4]
+    CACHE_NID, CACHE_X, CACHE_Y, CACHE_DEMAND, CACHE_OPEN, CACHE_CLOSE,
+    CACHE_SERVICE, CACHE_PID, CACHE_DID,
+    CACHE_OID, CACHE_OPID, CACHE_ODID, CACHE_ODIST, CACHE_ODIST2
+};
+
+const uint32_t CACHE_KIND = 0x50445056;     // "VPDP"
+const uint32_t CACHE_VERSION = 1;           // bump when the sections change
+
+
+// Load the nodes, the sorted orders and what is derived from them from
+// a cache made by saveCache() from a source file with hash key. Returns
+// false if the cache is missing or stale.
+bool Problem::loadCache(const std::string &file, uint64_t key)
+{
+    Cachefile cache;
+    if (!cache.open(file, CACHE_KIND, CACHE_VERSION, key))
+        return false;
+
+    size_t bytes = 0;
+    cache.section(CACHE_NID, &bytes);
+    int n = bytes / sizeof(int);
+    cache.section(CACHE_OID, &bytes);
+    int no = bytes / sizeof(int);
+
+    const int *header = cache.array<int>(CACHE_HEADER, 3);
+    const double *stats = cache.array<double>(CACHE_STATS, 5);
+    const int *nid = cache.array<int>(CACHE_NID, n);
+    const double *x = cache.array<double>(CACHE_X, n);
+    const double *y = cache.array<double>(CACHE_Y, n);
+    const int *demand = cache.array<int>(CACHE_DEMAND, n);
+    const int *twopen = cache.array<int>(CACHE_OPEN, n);
+    const int *twclose = cache.array<int>(CACHE_CLOSE, n);
+    const int *service = cache.array<int>(CACHE_SERVICE, n);
+    const int *pid = cache.array<int>(CACHE_PID, n);
+    const int *did = cache.array<int>(CACHE_DID, n);
+    const int *oid = cache.array<int>(CACHE_OID, no);
+    const int *opid = cache.array<int>(CACHE_OPID, no);
+    const int *odid = cache.array<int>(CACHE_ODID, no);
+    const double *odist = cache.array<double>(CACHE_ODIST, no);
+    const double *odist2 = cache.array<double>(CACHE_ODIST2, no);
+
+    if (!n or !header or !stats or !nid or !x or !y or !demand or !twopen
+            or !twclose or !service or !pid or !did or !oid or !opid
+            or !odid or !odist or !odist2)
+        return false;
+
+    K = header[0];
+    Q = header[1];
+    DepotClose = header[2];
+    atwl = stats[0];
+    for (int i=0; i<4; i++)
+        extents[i] = stats[i+1];
+
+    N.resize(n);
+    for (int i=0; i<n; i++) {
+        N[i].nid = nid[i];
+        N[i].x = x[i];
+        N[i].y = y[i];
+        N[i].demand = demand[i];
+        N[i].tw_open = twopen[i];
+        N[i].tw_close = twclose[i];
+        N[i].service = service[i];
+        N[i].pid = pid[i];
+        N[i].did = did[i];
+    }
+
+    O.resize(no);
+    for (int i=0; i<no; i++) {
+        O[i].oid = oid[i];
+        O[i].pid = opid[i];
+        O[i].did = odid[i];
+        O[i].dist = odist[i];
+        O[i].dist2 = odist2[i];
+    }
+
+    return true;
+}
+
+
+void Problem::saveCache(const std::string &file, uint64_t key) const
+{
+    int n = N.size();
+    std::vector<int> nid(n), demand(n), twopen(n), twclose(n), service(n);
+    std::vector<int> pid(n), did(n);
+    std::vector<double> x(n), y(n);
+    for (int i=0; i<n; i++) {
+        nid[i] = N[i].nid;
+        x[i] = N[i].x;
+        y[i] = N[i].y;
+        demand[i] = N[i].demand;
+        twopen[i] = N[i].tw_open;
+        twclose[i] = N[i].tw_close;
+        service[i] = N[i].service;
+        pid[i] = N[i].pid;
+        did[i] = N[i].did;
+    }
+
+    int no = O.size();
+    std::vector<int> oid(no), opid(no), odid(no);
+    std::vector<double> odist(no), odist2(no);
+    for (int i=0; i<no; i++) {
+        oid[i] = O[i].oid;
+        opid[i] = O[i].pid;
+        odid[i] = O[i].did;
+        odist[i] = O[i].dist;
+        odist2[i] = O[i].dist2;
+    }
+
+    std::vector<int> header(3);
+    header[0] = K;
+    header[1] = Q;
+    header[2] = DepotClose;
+    std::vector<double> stats(5);
+    stats[0] = atwl;
+    for (int i=0; i<4; i++)
+        stats[i+1] = extents[i];
+
+    Cachewriter w(file, CACHE_KIND, CACHE_VERSION, key);
+    w.add(CACHE_HEADER, header);
+    w.add(CACHE_STATS, stats);
+    w.add(CACHE_NID, nid);
+    w.add(CACHE_X, x);
+    w.add(CACHE_Y, y);
+    w.add(CACHE_DEMAND, demand);
+    w.add(CACHE_OPEN, twopen);
+    w.add(CACHE_CLOSE, twclose);
+    w.add(CACHE_SERVICE, service);
+    w.add(CACHE_PID, pid);
+    w.add(CACHE_DID, did);
+    w.add(CACHE_OID, oid);
+    w.add(CACHE_OPID, opid);
+    w.add(CACHE_ODID, odid);
+    w.add(CACHE_ODIST, odist);
+    w.add(CACHE_ODIST2, odist2);
+    w.commit();
+}
+
+
 void Problem::makeOrders ()
 {
     if (getNodeCount() == 0 || ((getNodeCount()-1)%2 != 0)) {
@@ -145,6 +377,56 @@ void Problem::makeOrders ()
 }
 
 
+// Add an order that arrived after the problem was prepared. The two nodes
+// get the next free nids and the order the next oid, so the orders must
+// be in oid order, as they are after Solution::sequentialConstruction().
+// Only what the new nodes change is updated: the order distances, the
+// extents and the average window length. Returns the oid.
+int Problem::addOrder(Node pickup, Node delivery)
+{
+    int pid = N.size();
+    int did = pid + 1;
+    if (O.size() && O.back().oid != O.size()-1) {
+        std::string errmsg = "Problem::addOrder - orders are not in oid order.";
+        throw std::runtime_error(errmsg);
+    }
+    if (dp && dp->size() <= did) {
+        std::string errmsg = "Problem::addOrder - the distances do not cover the new nodes.";
+        throw std::runtime_error(errmsg);
+    }
+
+    pickup.nid = pid;
+    pickup.pid = 0;
+    pickup.did = did;
+    delivery.nid = did;
+    delivery.pid = pid;
+    delivery.did = 0;
+
+    atwl = atwl * N.size() + (pickup.tw_close - pickup.tw_open)
+           + (delivery.tw_close - delivery.tw_open);
+    N.push_back(pickup);
+    N.push_back(delivery);
+    atwl /= N.size();
+
+    for (int i=pid; i<=did; i++) {
+        if (N[i].x < extents[0]) extents[0] = N[i].x;
+        if (N[i].y < extents[1]) extents[1] = N[i].y;
+        if (N[i].x > extents[2]) extents[2] = N[i].x;
+        if (N[i].y > extents[3]) extents[3] = N[i].y;
+    }
+
+    Order order;
+    order.oid = O.size();
+    order.pid = pid;
+    order.did = did;
+    order.dist = distance(0, pid);
+    order.dist2 = distance(did, 0);
+    O.push_back(order);
+
+    return order.oid;
+}
+
+
 void Problem::calcAvgTWLen() {
     // get the average time window length
     atwl = 0;
@@ -7,7 +7,9 @@
 #include <string>
 #include <vector>
 #include <math.h>
+#include <stdint.h>
 
+#include "distprovider.h"
 #include "Node.h"
 #include "Order.h"
 
@@ -27,19 +29,36 @@ class Problem {
     // variables for plotting
     double extents[4];
 
-    // Problem() {};
+    // travel times between the nodes, NULL to use the euclidean distance
+    // row i is N[i], the provider is not owned by the problem
+    const Distprovider *dp;
+
+    bool usecache;      // read and write the infile.cache sidecar
+
+    Problem() { dp = NULL; usecache = false; };
     // ~Problem() {};
 
     void loadProblem(char *infile);
+    void loadArrays(int _K, int _Q, int n, const int *nid,
+                    const double *x, const double *y, const int *demand,
+                    const int *tw_open, const int *tw_close,
+                    const int *service, const int *pid, const int *did);
+    void prepare();
+    bool loadCache(const std::string &file, uint64_t key);
+    void saveCache(const std::string &file, uint64_t key) const;
+    void setCache(bool _usecache) { usecache = _usecache; };
 
     unsigned int getNodeCount();
 
     unsigned int getOrderCount();
 
     double distance(int n1, int n2) const;
+    void setDistances(const Distprovider *_dp) { dp = _dp; };
 
     void makeOrders();
 
+    int addOrder(Node pickup, Node delivery);
+
     void dump();
 
     void calcAvgTWLen();
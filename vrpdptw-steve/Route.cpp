@@ -11,6 +11,7 @@ inline void swap(int a, int b) {
 
 Route::Route(Problem& p) : P(p) {
     updated = true;
+    locked = 0;
     D = 0;
     TWV = 0;
     CV = 0;
@@ -162,7 +163,8 @@ bool Route::insertOrder(int oid, bool mustBeValid) {
     std::vector<int> newpath;   // path with predecessor inserted
     std::vector<int> newpath2;  // path with predecessot and successor inserted
 
-    for (int i=0; i<path.size(); i++) {
+    // the served stops stay where they are
+    for (int i=locked; i<path.size(); i++) {
         newpath = path;
         std::vector<int>::iterator it2;
 
@@ -247,6 +249,30 @@ void Route::removeOrder(const int oid) {
     removeOrder(o);
 }
 
+
+// an order is locked once its pickup was served, it has to stay on
+// this vehicle until it is delivered
+bool Route::isLocked(int oid) const {
+    for (int i=0; i<locked && i<orders.size(); i++)
+        if (orders[i] == oid) return true;
+    return false;
+}
+
+// lock the stops whose service started by time t, the route is assumed
+// to have left the depot at time 0 like in testPath()
+void Route::lockServed(double t) {
+    double d = 0;
+    int i;
+    for (i=0; i<path.size(); i++) {
+        d += P.distance(i ? path[i-1] : 0, path[i]);
+        if (d < P.N[path[i]].tw_open)
+            d = P.N[path[i]].tw_open;
+        if (d > t) break;
+        d += P.N[path[i]].service;
+    }
+    if (i > locked) locked = i;
+}
+
 int Route::addPickup(const Order &o) {
     path.push_back(o.pid);
     orders.push_back(o.oid);
@@ -269,7 +295,7 @@ void Route::hillClimbOpt() {
     double oldcost = getCost();
     while (true) {
         bool improved = false;
-        for (int i=0; i<path.size(); i++) {
+        for (int i=locked; i<path.size(); i++) {
             for (int j=i+1; j<path.size(); j++) {
                 // don't move the delivery ahead of the pickup
                 if (orders[i] == orders[j]) continue;
@@ -26,6 +26,7 @@ class Route {
 //    std::vector<int> capacity;  // capacity after node is loaded
 //    std::vector<double> pdist;  // distance at node max(arrival time, tw_open)
     bool updated;
+    int locked;     // stops at the head of path that were already served
     double D;      // duration
     int TWV;    // TW violations
     int CV;     // capacity violations
@@ -40,7 +41,22 @@ class Route {
 
     // ~Route() {};
 
-    Route &operator = (const Route &r) { P = r.P; return *this; };
+    // copy everything but the problem, both routes share it
+    Route &operator = (const Route &r) {
+        rid = r.rid;
+        path = r.path;
+        orders = r.orders;
+        updated = r.updated;
+        locked = r.locked;
+        D = r.D;
+        TWV = r.TWV;
+        CV = r.CV;
+        cost = r.cost;
+        tD = r.tD;
+        tTWV = r.tTWV;
+        tCV = r.tCV;
+        return *this;
+    };
 
     void update();
 
@@ -56,6 +72,10 @@ class Route {
 
     void removeOrder(const int oid);
 
+    bool isLocked(int oid) const;
+
+    void lockServed(double t);
+
     int addPickup(const Order &o);
 
     void addDelivery(const Order &o);
@@ -1,4 +1,5 @@
 
+#include <limits>
 #include "Route.h"
 #include "Solution.h"
 
@@ -114,3 +115,57 @@ double Solution::getAverageRouteDurationLength() {
     }
     return len/n;
 }
+
+
+// Put an order that is not routed yet at its cheapest feasible place in
+// the existing routes, or on a route of its own if it fits nowhere.
+// Returns false if it needed a new route.
+bool Solution::insertOrder(int oid) {
+    if (oid >= mapOtoR.size())
+        mapOtoR.resize(P.O.size(), -1);
+
+    int best = -1;
+    double bestDelta = std::numeric_limits<double>::max();
+    for (int i=0; i<R.size(); i++) {
+        Route r(R[i]);
+        double oldc = r.getCost();
+        if (!r.insertOrder(oid, true)) continue;
+        double delta = r.getCost() - oldc;
+        if (delta < bestDelta) {
+            bestDelta = delta;
+            best = i;
+        }
+    }
+
+    if (best != -1) {
+        R[best].insertOrder(oid, true);
+        mapOtoR[oid] = best;
+        return true;
+    }
+
+    Route r(P);
+    r.rid = R.size();
+    r.addOrder(P.O[oid]);
+    mapOtoR[oid] = r.rid;
+    R.push_back(r);
+    return false;
+}
+
+
+// take an order off its route, it stays in the problem but is not
+// served anymore
+void Solution::cancelOrder(int oid) {
+    if (oid <= 0 || oid >= mapOtoR.size() || mapOtoR[oid] == -1) {
+        std::string errmsg = "Solution::cancelOrder - order is not on a route.";
+        throw std::runtime_error(errmsg);
+    }
+
+    Route &r(R[mapOtoR[oid]]);
+    if (r.isLocked(oid)) {
+        std::string errmsg = "Solution::cancelOrder - order was already picked up.";
+        throw std::runtime_error(errmsg);
+    }
+
+    r.removeOrder(oid);
+    mapOtoR[oid] = -1;
+}
@@ -41,11 +41,15 @@ class Solution {
 
     double getAverageRouteDurationLength();
 
+    bool insertOrder(int oid);
+
+    void cancelOrder(int oid);
+
+    // both solutions share the problem, it is not copied
     Solution& operator=( const Solution& rhs ) {
         if ( this != &rhs ) {
             totalDistance = rhs.totalDistance;
             totalCost = rhs.totalCost;
-            P = rhs.P;
             R = rhs.R;
             mapOtoR = rhs.mapOtoR;
         }
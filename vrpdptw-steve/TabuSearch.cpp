@@ -1,7 +1,14 @@
 
 #include "TabuSearch.h"
+#include "CheckpointWriter.h"
 #include "Plot.h"
+#include "cachefile.h"
 #include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+
+const int CHECKPOINT_VERSION = 2;      // bump when the format changes
 
 inline void swap(int& a, int& b) {
     int tmp = a;
@@ -17,22 +24,137 @@ inline void dumpvec(const std::vector<int>& v) {
     std::cout << std::endl;
 }
 
+template <class T>
+inline void put(std::string& d, T v) {
+    d.append((const char *) &v, sizeof(v));
+}
+
+template <class T>
+inline T get(const std::string& d, size_t& pos) {
+    T v;
+    if (pos + sizeof(v) > d.size()) {
+        std::string errmsg = "TabuSearch::loadCheckpoint - file is truncated.";
+        throw std::runtime_error(errmsg);
+    }
+    memcpy(&v, d.data() + pos, sizeof(v));
+    pos += sizeof(v);
+    return v;
+}
+
+// what a checkpoint must have been made on: the fleet, the nodes and the
+// orders in their sorted order
+static uint64_t problemHash(const Problem& P) {
+    std::string d;
+    put<int>(d, P.K);
+    put<int>(d, P.Q);
+    for (int i=0; i<P.N.size(); i++) {
+        const Node &n(P.N[i]);
+        put<int>(d, n.nid);
+        put<double>(d, n.x);
+        put<double>(d, n.y);
+        put<int>(d, n.demand);
+        put<int>(d, n.tw_open);
+        put<int>(d, n.tw_close);
+        put<int>(d, n.service);
+        put<int>(d, n.pid);
+        put<int>(d, n.did);
+    }
+    for (int i=0; i<P.O.size(); i++) {
+        const Order &o(P.O[i]);
+        put<int>(d, o.oid);
+        put<int>(d, o.pid);
+        put<int>(d, o.did);
+        put<double>(d, o.dist);
+        put<double>(d, o.dist2);
+    }
+    return Cachefile::hash(d.data(), d.size());
+}
+
+static void putSolution(std::string& d, const Solution& s) {
+    put<int>(d, s.R.size());
+    for (int i=0; i<s.R.size(); i++) {
+        const Route &r(s.R[i]);
+        put<int>(d, r.rid);
+        put<int>(d, r.locked);
+        put<int>(d, r.path.size());
+        for (int j=0; j<r.path.size(); j++) {
+            put<int>(d, r.path[j]);
+            put<int>(d, r.orders[j]);
+        }
+    }
+}
+
+static void getSolution(const std::string& d, size_t& pos, Solution& s) {
+    int nN = s.P.N.size();
+    int nO = s.P.O.size();
+
+    s.R.clear();
+    s.mapOtoR.assign(nO, -1);
+
+    int nR = get<int>(d, pos);
+    for (int i=0; i<nR; i++) {
+        Route r(s.P);
+        r.rid = get<int>(d, pos);
+        r.locked = get<int>(d, pos);
+        int len = get<int>(d, pos);
+        // mapOtoR indexes R by rid and the locked stops must be on the path
+        if (r.rid != i || len < 0 || r.locked < 0 || r.locked > len) {
+            std::string errmsg = "TabuSearch::loadCheckpoint - bad route " + std::to_string(i) + ".";
+            throw std::runtime_error(errmsg);
+        }
+        for (int j=0; j<len; j++) {
+            int nid = get<int>(d, pos);
+            int oid = get<int>(d, pos);
+            if (nid < 0 || nid >= nN || oid < 0 || oid >= nO) {
+                std::string errmsg = "TabuSearch::loadCheckpoint - node or order out of range.";
+                throw std::runtime_error(errmsg);
+            }
+            r.path.push_back(nid);
+            r.orders.push_back(oid);
+            s.mapOtoR[oid] = r.rid;
+        }
+        r.updated = true;
+        s.R.push_back(r);
+    }
+    s.computeCosts();
+}
+
 
 Solution TabuSearch::solve() {
 
     T.clear();      // clear the Tabu list
+    iter = 0;   // init the iteration counter
+
+    return resume(500);
+}
+
+
+// Run maxIter more iterations from the current solution, the tabu list and
+// the iteration counter are kept from the previous call. After orders were
+// added or cancelled this continues the search warm instead of starting
+// over from a new construction.
+Solution TabuSearch::resume(int maxIter) {
+
     tabuLength = std::max(30, (int)S.P.O.size());
-std::cout << "tabuLength: " << tabuLength << std::endl;
+if (verbose) std::cout << "tabuLength: " << tabuLength << std::endl;
 
-    iter = 0;   // init the iteration counter
-    int maxIter = 500;
+    maxIter += iter;
 
     // get the average time window length
     double atwl = S.P.atwl;
 
-    while (iter++ < maxIter) {
+    // the snapshots are written while the search goes on
+    std::unique_ptr<CheckpointWriter> ckpt;
+    std::string snapshot;
+    if (checkpointEvery > 0 && checkpointFile.size())
+        ckpt.reset(new CheckpointWriter(checkpointFile));
 
-std::cout << "---------- TabuSearch::solve: iter: " << iter << std::endl;
+    // iter counts the iterations done, it is maxIter after the loop so
+    // the next resume() and the last checkpoint start from there
+    while (iter < maxIter) {
+        iter++;
+
+if (verbose) std::cout << "---------- TabuSearch::solve: iter: " << iter << std::endl;
 
         int nwri = S.P.N.size()/14;
         double ardl = S.getAverageRouteDurationLength();
@@ -56,6 +178,11 @@ std::cout << "---------- TabuSearch::solve: iter: " << iter << std::endl;
 
         cleanTabuList();
 
+        if (ckpt && iter % checkpointEvery == 0) {
+            checkpoint(snapshot);
+            ckpt->post(snapshot);
+        }
+
         if (debugPlots) {
             Plot plot(S);
             char file[100];
@@ -65,16 +192,123 @@ std::cout << "---------- TabuSearch::solve: iter: " << iter << std::endl;
 
     }
 
+    // where the next resume() starts
+    if (ckpt) {
+        checkpoint(snapshot);
+        ckpt->post(snapshot);
+    }
+
 //std::cout << "TabuSearch::solve: Best Solution is: " << std::endl;
 //Best.dump();
 
+if (verbose) {
 std::cout << "TabuSearch::solve: TabuList" << std::endl;
 for (int i=0; i<T.size(); i++)
     T[i].dump();
+}
 
     return S;
 }
 
+Solution TabuSearch::resumeUntil(int lastIter) {
+    return resume(std::max(0, lastIter - iter));
+}
+
+
+// A checkpoint is the magic "TSCK", a format version, the number of nodes
+// and orders of the problem and a hash of them, iter, tabuLength, SCost,
+// BestCost, then S and Best and last the tabu list. A solution is its number of routes and for
+// each route rid, locked, the path length and the nid, oid of every stop.
+// Everything is in the byte order of the host that wrote it.
+void TabuSearch::checkpoint(std::string &data) const {
+    data.clear();
+    data.append("TSCK", 4);
+    put<int>(data, CHECKPOINT_VERSION);
+    put<int>(data, S.P.N.size());
+    put<int>(data, S.P.O.size());
+    put<uint64_t>(data, problemHash(S.P));
+    put<int>(data, iter);
+    put<int>(data, tabuLength);
+    put<double>(data, SCost);
+    put<double>(data, BestCost);
+    putSolution(data, S);
+    putSolution(data, Best);
+    put<int>(data, T.size());
+    for (int i=0; i<T.size(); i++) {
+        put<int>(data, T[i].node);
+        put<int>(data, T[i].torid);
+        put<int>(data, T[i].topos);
+        put<int>(data, T[i].expires);
+        put<int>(data, T[i].checked);
+        put<int>(data, T[i].aspirational);
+        put<int>(data, T[i].move);
+    }
+}
+
+
+// restore the state of a checkpoint of a search on the same problem,
+// resume() then continues where that search was
+void TabuSearch::loadCheckpoint(const std::string &file) {
+    std::ifstream in(file.c_str(), std::ios::binary);
+    if (!in) {
+        std::string errmsg = "TabuSearch::loadCheckpoint - can not open '" + file + "'.";
+        throw std::runtime_error(errmsg);
+    }
+    std::stringstream buf;
+    buf << in.rdbuf();
+    std::string data = buf.str();
+
+    if (data.compare(0, 4, "TSCK", 4)) {
+        std::string errmsg = "TabuSearch::loadCheckpoint - '" + file + "' is not a checkpoint.";
+        throw std::runtime_error(errmsg);
+    }
+    size_t pos = 4;
+    if (get<int>(data, pos) != CHECKPOINT_VERSION) {
+        std::string errmsg = "TabuSearch::loadCheckpoint - unknown checkpoint version.";
+        throw std::runtime_error(errmsg);
+    }
+    int nN = get<int>(data, pos);
+    int nO = get<int>(data, pos);
+    uint64_t h = get<uint64_t>(data, pos);
+    if (nN != S.P.N.size() || nO != S.P.O.size() || h != problemHash(S.P)) {
+        std::string errmsg = "TabuSearch::loadCheckpoint - checkpoint is for another problem.";
+        throw std::runtime_error(errmsg);
+    }
+
+    // nothing is changed before the whole file was read
+    Solution s(S.P);
+    Solution best(S.P);
+    std::vector<Tabu> t;
+
+    int it = get<int>(data, pos);
+    int length = get<int>(data, pos);
+    double scost = get<double>(data, pos);
+    double bestcost = get<double>(data, pos);
+    getSolution(data, pos, s);
+    getSolution(data, pos, best);
+    int nT = get<int>(data, pos);
+    for (int i=0; i<nT; i++) {
+        Tabu tm;
+        tm.node = get<int>(data, pos);
+        tm.torid = get<int>(data, pos);
+        tm.topos = get<int>(data, pos);
+        tm.expires = get<int>(data, pos);
+        tm.checked = get<int>(data, pos);
+        tm.aspirational = get<int>(data, pos);
+        tm.move = get<int>(data, pos);
+        t.push_back(tm);
+    }
+
+    iter = it;
+    tabuLength = length;
+    S = s;
+    SCost = scost;
+    Best = best;
+    BestCost = bestcost;
+    T.swap(t);
+}
+
+
 //SPI - Single Pair Insertion
     // for each route
         // get the route
@@ -98,11 +332,8 @@ bool TabuSearch::doSPI() {
 
     // oid==0 is the depot
     for ( int oid=1; oid<S.P.O.size(); oid++) {
-        if (S.mapOtoR[oid] == -1) {
-            std::cout << "ERROR: S.mapOtoR[oid] == -1 for oid: "
-                      << oid << std::endl;
-            continue;
-        }
+        // cancelled orders are on no route, picked up ones stay put
+        if (!isMovable(oid)) continue;
 
         // copy the route this order is in and get the cost with the order
         Route r1(S.R[S.mapOtoR[oid]]);
@@ -190,8 +421,10 @@ m.dump();
     // if we found no valid moves, return false
     if (bestMove.moveType == -1) return false;
 
+if (verbose) {
 std::cout << "SPI: BestMove: SCost: " << SCost << ": ";
 bestMove.dump();
+}
 
     // otherwise update the current solution and apply the best move
     applyMove(bestMove);
@@ -204,7 +437,7 @@ bestMove.dump();
 
 
 bool TabuSearch::doSBR() {
-std::cout << "Enter TabuSearch::doSBR(): " << std::endl;;
+if (verbose) std::cout << "Enter TabuSearch::doSBR(): " << std::endl;;
     // initialize bestMove
     bestMove.moveType = -1;
     bestMove.savings = -std::numeric_limits<double>::max();
@@ -212,10 +445,12 @@ std::cout << "Enter TabuSearch::doSBR(): " << std::endl;;
     // for each order
     // oid==0 is the depot
     for ( int oid1=1; oid1<S.P.O.size(); oid1++) {
+        if (!isMovable(oid1)) continue;
         int currentRoute = S.mapOtoR[oid1];
         // swap it for another order not in the current route
         for ( int oid2=1; oid2<S.P.O.size(); oid2++) {
             if (oid1 == oid2) continue;
+            if (!isMovable(oid2)) continue;
             if (currentRoute == S.mapOtoR[oid2]) continue;
             Route r1(S.R[currentRoute]);
             double r1oldc = r1.getCost();
@@ -290,8 +525,10 @@ if (m.ppos1 == -1 || m.spos1 == -1 || m.ppos2 == -1 || m.spos2 == -1 ) {
     if (bestMove.moveType == -1)
         return false;
 
+if (verbose) {
 std::cout << "SBR: BestMove: SCost: " << SCost << ": ";
 bestMove.dump();
+}
 
     // otherwise update the current solution and apply the best move
     applyMove(bestMove);
@@ -318,10 +555,11 @@ bool TabuSearch::doWRI() {
         Route& r(S.R[rid]);
         double roldc = r.getCost();
 
-        for (int i=0; i<r.path.size(); i++) {
+        // the served stops stay where they are
+        for (int i=r.locked; i<r.path.size(); i++) {
             // move it forward
             np = r.path;
-            for (int j=i-1; j>=0; j--) {
+            for (int j=i-1; j>=r.locked; j--) {
                 Move m;
                 // we cant move a successor before its predecessor
                 if (r.orders[i] == r.orders[j]) break;
@@ -390,8 +628,10 @@ bool TabuSearch::doWRI() {
     if (bestMove.moveType == -1 || bestMove.savings <= 0)
         return false;
 
+if (verbose) {
 std::cout << "WRI: BestMove: SCost: " << SCost << ": ";
 bestMove.dump();
+}
 
     // otherwise update the current solution and apply the best move
     applyMove(bestMove);
@@ -695,7 +935,7 @@ bool TabuSearch::isTabu(Tabu& tm) {
 
 
 void TabuSearch::cleanTabuList() {
-    while (T.back().expires < iter) {
+    while (T.size() && T.back().expires < iter) {
         if (debugTabu) {
             std::cout << "TABU: cleaned expired at (" << iter << "): ";
             T.back().dump();
@@ -705,4 +945,52 @@ void TabuSearch::cleanTabuList() {
 }
 
 
+// the order is on a route and has not been picked up yet
+bool TabuSearch::isMovable(int oid) {
+    int rid = S.mapOtoR[oid];
+    return rid != -1 && !S.R[rid].isLocked(oid);
+}
+
+
+// the problem changed under the search, the current solution is the
+// only one we know to be valid for it
+void TabuSearch::restart() {
+    S.computeCosts();
+    SCost = BestCost = S.getCost();
+    Best = S;
+}
+
+
+// add a new order to the problem and to the cheapest place in the
+// current solution, returns its oid
+int TabuSearch::addOrder(const Node &pickup, const Node &delivery) {
+    int oid = S.P.addOrder(pickup, delivery);
+    S.insertOrder(oid);
+    restart();
+    return oid;
+}
+
+
+void TabuSearch::cancelOrder(int oid) {
+    S.cancelOrder(oid);
+    restart();
+}
 
+
+// the first nstops of route rid were served and can not change anymore
+void TabuSearch::lockPrefix(int rid, int nstops) {
+    if (rid < 0 || rid >= S.R.size() || nstops < 0
+            || nstops > S.R[rid].path.size()) {
+        std::string errmsg = "TabuSearch::lockPrefix - no such route or stop.";
+        throw std::runtime_error(errmsg);
+    }
+    if (nstops > S.R[rid].locked)
+        S.R[rid].locked = nstops;
+}
+
+
+// lock the stops that all the routes served by time t
+void TabuSearch::lockServed(double t) {
+    for (int i=0; i<S.R.size(); i++)
+        S.R[i].lockServed(t);
+}
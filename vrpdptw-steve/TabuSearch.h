@@ -32,6 +32,10 @@ class TabuSearch {
 
     bool debugTabu;
     bool debugPlots;
+    bool verbose;       // report the moves and iterations on std::cout
+
+    std::string checkpointFile;
+    int checkpointEvery;    // iterations between checkpoints, 0 = none
 
     TabuSearch(Solution &s) : S(s), Best(s) {
         iter = 0;
@@ -39,10 +43,38 @@ class TabuSearch {
         SCost = BestCost = Best.getCost();  // cost of the best
         debugTabu = false;
         debugPlots = false;
+        verbose = true;
+        checkpointEvery = 0;
     };
 
     Solution solve();
 
+    // maxIter more iterations, iter counts on from the last run or from
+    // loadCheckpoint(), so this is not where a checkpointed run stopped
+    Solution resume(int maxIter);
+
+    // run until iter is lastIter, after loadCheckpoint() this finishes what
+    // the checkpointed run had left, e.g. resumeUntil(500) after solve()
+    Solution resumeUntil(int lastIter);
+
+    // the state resume() needs, see TabuSearch.cpp for the format
+    void checkpoint(std::string &data) const;
+
+    void loadCheckpoint(const std::string &file);
+
+    // orders that come and go while the routes are driven, see resume()
+    int addOrder(const Node &pickup, const Node &delivery);
+
+    void cancelOrder(int oid);
+
+    void lockPrefix(int rid, int nstops);
+
+    void lockServed(double t);
+
+    void restart();
+
+    bool isMovable(int oid);
+
     bool doSPI();
 
     bool doSBR();
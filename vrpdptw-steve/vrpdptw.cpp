@@ -8,6 +8,7 @@
 #include <vector>
 #include <math.h>
 
+#include "mmatrix.h"
 #include "Node.h"
 #include "Order.h"
 #include "Problem.h"
@@ -24,7 +25,10 @@ static Problem P;
 
 void Usage()
 {
-    std::cout << "Usage: vrpdptw in.txt\n";
+    std::cout << "Usage: vrpdptw in.txt [matrix.mtx] [-c checkpoint]\n";
+    std::cout << "  -c checkpoint  run the tabu search with a checkpoint every\n";
+    std::cout << "                 50 iterations in this file, continue from it\n";
+    std::cout << "                 if it exists\n";
 }
 
 
@@ -36,8 +40,27 @@ int main (int argc, char **argv)
     }
 
     char * infile = argv[1];
+    char * mtxfile = NULL;
+    char * ckfile = NULL;
+    for (int i=2; i<argc; i++) {
+        if (std::string(argv[i]) == "-c" and i+1 < argc)
+            ckfile = argv[++i];
+        else if (!mtxfile and argv[i][0] != '-')
+            mtxfile = argv[i];
+        else {
+            Usage();
+            return 1;
+        }
+    }
 
     try {
+        // road network travel times instead of euclidean distances
+        Mmatrix times;
+        if (mtxfile) {
+            times.open(mtxfile);
+            P.setDistances(&times);
+        }
+
         P.loadProblem(infile);
         std::cout << "Problem '" << infile << "'loaded\n";
         P.dump();
@@ -49,6 +72,28 @@ int main (int argc, char **argv)
         std::cout << "Initial Solution: SCost: " << S.getCost() << std::endl;
         S.dump();
 
+        // a run that was stopped goes on from its last checkpoint and
+        // finishes the 500 iterations of solve()
+        if (ckfile) {
+            TabuSearch TS(S);
+            TS.verbose = false;
+            TS.checkpointFile = ckfile;
+            TS.checkpointEvery = 50;
+            std::ifstream probe(ckfile);
+            if (probe) {
+                probe.close();
+                TS.loadCheckpoint(ckfile);
+                std::cout << "Resumed '" << ckfile << "' at iteration "
+                          << TS.iter << std::endl;
+            }
+            Solution B = TS.resumeUntil(500);
+            B.computeCosts();
+            std::cout << "TabuSearch Results: iter: " << TS.iter
+                      << ", SCost: " << B.getCost() << std::endl;
+            B.dump();
+            return 0;
+        }
+
 return 0;
 
 #if 1
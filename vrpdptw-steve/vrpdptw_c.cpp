@@ -0,0 +1,132 @@
+
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "distprovider.h"
+#include "Problem.h"
+#include "Solution.h"
+#include "GeneticSearch.h"
+#include "IslandSearch.h"
+#include "TabuSearch.h"
+#include "vrpdptw_c.h"
+
+// the caller's matrix, read in place
+class Arraymatrix : public Distprovider {
+  private:
+    int n;
+    const double *cells;
+
+  public:
+    int size() const { return n; };
+    double distance(int i, int j) const { return cells[(size_t) i * n + j]; };
+
+    Arraymatrix(int _n, const double *_cells) : n(_n), cells(_cells) {};
+};
+
+
+static void seterror(char *err, size_t errlen, const char *msg) {
+    if (!err or !errlen) return;
+    strncpy(err, msg, errlen - 1);
+    err[errlen - 1] = '\0';
+}
+
+
+// copy the routes of S into out, the arrival times are worked out the
+// same way as Route::update() does
+static int writeRoutes(const Problem &P, Solution &S, vrpdptw_output *out) {
+    int rows = 0;
+    out->nroutes = 0;
+    for (int r=0; r<S.R.size(); r++) {
+        const std::vector<int> &path = S.R[r].path;
+        if (!path.size()) continue;
+
+        double D = 0.0;
+        for (int i=0; i<path.size(); i++) {
+            D += P.distance(i ? path[i-1] : 0, path[i]);
+            if (rows < out->maxrows) {
+                out->route[rows] = out->nroutes;
+                out->node[rows] = path[i];
+                if (out->arrival) out->arrival[rows] = D;
+            }
+            rows++;
+
+            if (D < P.N[path[i]].tw_open)
+                D = P.N[path[i]].tw_open;
+            D += P.N[path[i]].service;
+        }
+        out->nroutes++;
+    }
+
+    S.computeCosts();
+    out->nrows = rows;
+    out->cost = S.getCost();
+    out->distance = S.getDistance();
+    return rows <= out->maxrows ? VRPDPTW_OK : VRPDPTW_TOOSMALL;
+}
+
+
+extern "C" int vrpdptw_solve(const vrpdptw_input *in, vrpdptw_output *out,
+                             char *err, size_t errlen) {
+    if (!in or !out) {
+        seterror(err, errlen, "vrpdptw_solve - no input or output.");
+        return VRPDPTW_ERROR;
+    }
+    out->nrows = 0;
+    out->nroutes = 0;
+    out->cost = 0.0;
+    out->distance = 0.0;
+
+    // exceptions must not get into C code
+    try {
+        // the orders are made with the distances, so set them first
+        Problem P;
+        Arraymatrix times(in->nnodes, in->matrix);
+        if (in->matrix)
+            P.setDistances(&times);
+
+        P.loadArrays(in->vehicles, in->capacity, in->nnodes, in->nid,
+                     in->x, in->y, in->demand, in->tw_open, in->tw_close,
+                     in->service, in->pid, in->did);
+
+        Solution S(P);
+        S.sequentialConstruction();
+        S.computeCosts();
+
+        if (!in->improve)
+            return writeRoutes(P, S, out);
+
+        if (in->improve == 2) {
+            GeneticSearch GS(S);
+            if (in->maxiter > 0) GS.maxIter = in->maxiter;
+            if (in->eduiter > 0) GS.eduIter = in->eduiter;
+            GS.maxTime = in->maxtime;
+            GS.verbose = false;
+            Solution B = GS.solve();
+            return writeRoutes(P, B, out);
+        }
+
+        if (in->improve == 3) {
+            IslandSearch IS(S);
+            if (in->islands > 0) IS.nislands = in->islands;
+            if (in->epochs > 0) IS.epochs = in->epochs;
+            if (in->maxiter > 0) IS.interval = in->maxiter;
+            IS.verbose = false;
+            Solution B = IS.solve();
+            return writeRoutes(P, B, out);
+        }
+
+        TabuSearch TS(S);
+        TS.verbose = false;     // the caller's stdout is not ours
+        Solution B = in->maxiter > 0 ? TS.resume(in->maxiter) : TS.solve();
+        return writeRoutes(P, B, out);
+    }
+    catch (const std::exception &e) {
+        seterror(err, errlen, e.what());
+        return VRPDPTW_ERROR;
+    }
+    catch (...) {
+        seterror(err, errlen, "vrpdptw_solve - unknown error.");
+        return VRPDPTW_ERROR;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef VRPDPTW_C_H
+#define VRPDPTW_C_H
+
+/*
+    C interface to the solver for callers that already have the problem
+    in memory, like a pgRouting function that has just run its query.
+    Nothing goes through files. The caller owns every array, the solver
+    only reads the input arrays and writes the routes into the output
+    arrays it is given.
+
+    Node i of the input arrays must have nid i and node 0 is the depot,
+    the same as in the text files. Each pickup has pid 0 and did set to
+    its delivery, each delivery has pid set to its pickup and did 0.
+
+    matrix is optional, with it the travel time from node i to node j is
+    matrix[i*nnodes+j] instead of the euclidean distance. It is read in
+    place for the whole solve.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* return values of vrpdptw_solve() */
+#define VRPDPTW_OK          0
+#define VRPDPTW_ERROR      -1   /* the message is in err */
+#define VRPDPTW_TOOSMALL   -2   /* the routes need more than maxrows rows */
+
+typedef struct {
+    int vehicles;           /* K, number of vehicles */
+    int capacity;           /* Q, capacity of each vehicle */
+    int nnodes;             /* length of the node arrays */
+    const int *nid;
+    const double *x;
+    const double *y;
+    const int *demand;
+    const int *tw_open;
+    const int *tw_close;
+    const int *service;
+    const int *pid;
+    const int *did;
+    const double *matrix;   /* nnodes*nnodes row major, NULL for euclidean */
+    int improve;            /* after the construction run 1 - the tabu search,
+                               2 - the genetic search, 3 - the island search,
+                               0 - nothing */
+    int maxiter;            /* iterations of the tabu search or children of
+                               the genetic search, 0 for the default of 500
+                               iterations or 2000 children; for the island
+                               search the iterations or children of an
+                               epoch, 0 for the default of 50 */
+    int eduiter;            /* tabu search iterations that educate a child of
+                               the genetic search, 0 for the default of 25 */
+    double maxtime;         /* seconds the genetic search may run, it stops
+                               at the next batch of children, 0 - no limit */
+    int islands;            /* processes the island search forks, 0 - one
+                               per core */
+    int epochs;             /* exchanges between the islands, 0 for the
+                               default of 10 */
+} vrpdptw_input;
+
+/*
+    One row for each stop of each route, in order. The depot at the
+    start and end of the routes is not listed.
+*/
+typedef struct {
+    int maxrows;            /* length of the arrays below */
+    int *route;             /* route of the stop, 0 based */
+    int *node;              /* nid of the stop */
+    double *arrival;        /* arrival time at the stop, can be NULL */
+
+    int nrows;              /* rows written, or needed for VRPDPTW_TOOSMALL */
+    int nroutes;
+    double cost;
+    double distance;
+} vrpdptw_output;
+
+int vrpdptw_solve(const vrpdptw_input *in, vrpdptw_output *out,
+                  char *err, size_t errlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,184 @@
+/*
+    Checks of the C interface in vrpdptw_c.h, run by make test.
+
+    Usage: vrpdptw_test in.txt
+
+    Solves the problem with euclidean distances and again with the same
+    distances given as a matrix, the construction must cost the same.
+    Then checks that too few rows give VRPDPTW_TOOSMALL with the rows
+    that are needed, runs short tabu, genetic and island searches and checks
+    that bad input gives VRPDPTW_ERROR. Exits 1 if
+    any check fails.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vrpdptw_c.h"
+
+#define MAXNODES 1000
+
+static int nid[MAXNODES], demand[MAXNODES], tw_open[MAXNODES];
+static int tw_close[MAXNODES], service[MAXNODES], pid[MAXNODES], did[MAXNODES];
+static double x[MAXNODES], y[MAXNODES];
+
+static int failed = 0;
+
+static void check(int ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) failed = 1;
+}
+
+/* the same text format as Problem::loadProblem() */
+static int readProblem(const char *file, vrpdptw_input *in) {
+    FILE *f = fopen(file, "r");
+    int n = 0;
+    if (!f) return 0;
+    memset(in, 0, sizeof *in);
+    if (fscanf(f, "%d %d %*[^\n]", &in->vehicles, &in->capacity) != 2) {
+        fclose(f);
+        return 0;
+    }
+    while (n < MAXNODES
+           && fscanf(f, "%d %lf %lf %d %d %d %d %d %d", &nid[n], &x[n], &y[n],
+                      &demand[n], &tw_open[n], &tw_close[n], &service[n],
+                      &pid[n], &did[n]) == 9)
+        n++;
+    fclose(f);
+
+    in->nnodes = n;
+    in->nid = nid;
+    in->x = x;
+    in->y = y;
+    in->demand = demand;
+    in->tw_open = tw_open;
+    in->tw_close = tw_close;
+    in->service = service;
+    in->pid = pid;
+    in->did = did;
+    return n;
+}
+
+static int solve(const vrpdptw_input *in, vrpdptw_output *out, int maxrows) {
+    static int route[2*MAXNODES], node[2*MAXNODES];
+    static double arrival[2*MAXNODES];
+    char err[256] = "";
+    int rc;
+
+    out->maxrows = maxrows;
+    out->route = route;
+    out->node = node;
+    out->arrival = arrival;
+    rc = vrpdptw_solve(in, out, err, sizeof err);
+    if (rc == VRPDPTW_ERROR) printf("      %s\n", err);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    vrpdptw_input in;
+    vrpdptw_output out;
+    double cost, *matrix;
+    int n, i, j, rows, rc;
+
+    if (argc < 2) {
+        printf("Usage: vrpdptw_test in.txt\n");
+        return 1;
+    }
+    n = readProblem(argv[1], &in);
+    if (n < 3) {
+        printf("vrpdptw_test - can not read '%s'\n", argv[1]);
+        return 1;
+    }
+
+    rc = solve(&in, &out, 2*MAXNODES);
+    printf("      euclidean: %d routes, %d rows, cost %.4f\n",
+           out.nroutes, out.nrows, out.cost);
+    check(rc == VRPDPTW_OK && out.nrows == n-1, "euclidean solve");
+    cost = out.cost;
+    rows = out.nrows;
+
+    matrix = malloc((size_t) n * n * sizeof(double));
+    for (i=0; i<n; i++)
+        for (j=0; j<n; j++)
+            matrix[(size_t) i*n+j] = sqrt((x[i]-x[j])*(x[i]-x[j]) + (y[i]-y[j])*(y[i]-y[j]));
+    in.matrix = matrix;
+    rc = solve(&in, &out, 2*MAXNODES);
+    printf("      matrix:    %d routes, %d rows, cost %.4f\n",
+           out.nroutes, out.nrows, out.cost);
+    check(rc == VRPDPTW_OK && fabs(out.cost - cost) < 1e-6,
+          "matrix solve has the euclidean cost");
+    in.matrix = NULL;
+
+    rc = solve(&in, &out, 4);
+    check(rc == VRPDPTW_TOOSMALL && out.nrows == rows,
+          "too few rows give VRPDPTW_TOOSMALL and the rows needed");
+
+    /* short runs of the searches, the genetic search keeps its best */
+    in.improve = 1;
+    in.maxiter = 50;
+    rc = solve(&in, &out, 2*MAXNODES);
+    printf("      tabu:      %d routes, %d rows, cost %.4f\n",
+           out.nroutes, out.nrows, out.cost);
+    check(rc == VRPDPTW_OK && out.nrows == rows, "tabu search of 50 iterations");
+
+    in.improve = 2;
+    in.maxiter = 8;
+    in.eduiter = 5;
+    in.maxtime = 60.0;
+    rc = solve(&in, &out, 2*MAXNODES);
+    printf("      genetic:   %d routes, %d rows, cost %.4f\n",
+           out.nroutes, out.nrows, out.cost);
+    check(rc == VRPDPTW_OK && out.nrows == rows && out.cost <= cost + 1e-6,
+          "genetic search of 8 children");
+
+    in.maxiter = 0;
+    in.maxtime = 0.001;
+    rc = solve(&in, &out, 2*MAXNODES);
+    check(rc == VRPDPTW_OK && out.nrows == rows && out.cost <= cost + 1e-6,
+          "genetic search stops at maxtime");
+
+    /* two forked islands, a tabu and a genetic one, that meet twice, a
+       better cost can only have come back through the ring */
+    in.improve = 3;
+    in.islands = 2;
+    in.epochs = 2;
+    in.maxiter = 10;
+    in.maxtime = 0.0;
+    rc = solve(&in, &out, 2*MAXNODES);
+    printf("      islands:   %d routes, %d rows, cost %.4f\n",
+           out.nroutes, out.nrows, out.cost);
+    check(rc == VRPDPTW_OK && out.nrows == rows && out.cost < cost - 1e-6,
+          "island search of 2 islands and 2 epochs");
+    in.improve = 0;
+    in.maxiter = 0;
+    in.eduiter = 0;
+    in.islands = 0;
+    in.epochs = 0;
+
+    /* the first two pickups, the bad input is made from them */
+    for (i=1; i<n && pid[i] != 0; i++) ;
+    for (j=i+1; j<n && pid[j] != 0; j++) ;
+
+    did[i] = n + 5;
+    check(solve(&in, &out, 2*MAXNODES) == VRPDPTW_ERROR, "did out of range");
+    readProblem(argv[1], &in);
+
+    did[i] = did[j];
+    check(solve(&in, &out, 2*MAXNODES) == VRPDPTW_ERROR,
+          "a pickup with the delivery of another pickup");
+    readProblem(argv[1], &in);
+
+    did[0] = did[i];
+    check(solve(&in, &out, 2*MAXNODES) == VRPDPTW_ERROR, "node 0 is not the depot");
+    readProblem(argv[1], &in);
+
+    in.nnodes = 2;
+    check(solve(&in, &out, 2*MAXNODES) == VRPDPTW_ERROR, "too few nodes");
+    in.nnodes = n;
+
+    free(matrix);
+    printf(failed ? "vrpdptw_test: FAILED\n" : "vrpdptw_test: passed\n");
+    return failed;
+}
@@ -0,0 +1,187 @@
+/*
+    Checks of the warm start in TabuSearch, run by make test.
+
+    Usage: warm_test in.txt
+
+    Checkpoints a run at 60 iterations, resumes it from the file to 120
+    iterations and compares it with a run of 120 iterations. Then solves
+    the problem, locks what the routes served by a time and the
+    head of one route, cancels some orders that were not picked up, adds
+    a new order and resumes the search. The locked stops must still head
+    their routes, every order on the routes must be there once with the
+    pickup before the delivery and the cancelled orders must be gone.
+    Exits 1 if any check fails.
+*/
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Problem.h"
+#include "Solution.h"
+#include "TabuSearch.h"
+
+static Problem P;
+
+static bool failed = false;
+
+static void check(bool ok, const std::string &what) {
+    std::cout << (ok ? "ok  : " : "FAIL: ") << what << std::endl;
+    if (!ok) failed = true;
+}
+
+// every order on the routes is there once with the pickup first and
+// mapOtoR agrees, the orders in skip are on no route
+static bool routesAreSound(const Solution &S, const std::vector<int> &skip) {
+    std::vector<int> seen(S.P.O.size(), 0);
+    for (int r=0; r<S.R.size(); r++) {
+        const Route &R = S.R[r];
+        for (int i=0; i<R.path.size(); i++) {
+            int oid = R.orders[i];
+            if (S.mapOtoR[oid] != r) return false;
+            bool pickup = R.path[i] == S.P.O[oid].pid;
+            if (pickup != (seen[oid] == 0)) return false;
+            seen[oid]++;
+        }
+    }
+    for (int oid=1; oid<seen.size(); oid++) {
+        bool skipped = std::find(skip.begin(), skip.end(), oid) != skip.end();
+        if (seen[oid] != (skipped ? 0 : 2)) return false;
+    }
+    return true;
+}
+
+static bool sameRoutes(const Solution &a, const Solution &b) {
+    if (a.R.size() != b.R.size()) return false;
+    for (int r=0; r<a.R.size(); r++)
+        if (a.R[r].path != b.R[r].path) return false;
+    return true;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cout << "Usage: warm_test in.txt\n";
+        return 1;
+    }
+
+    try {
+        P.loadProblem(argv[1]);
+
+        // a run stopped after its checkpoint at 60 and resumed from the
+        // file has to end where a run that was never stopped ends
+        std::string ckfile = std::string(argv[1]) + ".ckpt";
+        std::remove(ckfile.c_str());
+        Solution C(P);
+        C.sequentialConstruction();
+        C.computeCosts();
+        {
+            TabuSearch A(C);
+            A.verbose = false;
+            A.checkpointFile = ckfile;
+            A.checkpointEvery = 60;
+            A.resumeUntil(60);
+        }
+        TabuSearch B(C);
+        B.verbose = false;
+        B.loadCheckpoint(ckfile);
+        B.resumeUntil(120);
+        std::remove(ckfile.c_str());
+
+        TabuSearch D(C);
+        D.verbose = false;
+        D.resumeUntil(120);
+        std::cout << "      checkpointed: iter " << B.iter << ", cost " << B.SCost
+                  << ", best " << B.BestCost << std::endl;
+        std::cout << "      straight:     iter " << D.iter << ", cost " << D.SCost
+                  << ", best " << D.BestCost << std::endl;
+        check(B.iter == 120 && D.iter == 120 && B.BestCost == D.BestCost
+              && sameRoutes(B.S, D.S) && sameRoutes(B.Best, D.Best),
+              "a run resumed from its checkpoint matches a straight run");
+
+        Solution S(P);
+        S.sequentialConstruction();
+        S.computeCosts();
+
+        TabuSearch TS(S);
+        TS.verbose = false;
+        TS.solve();
+        std::cout << "      solved: " << TS.S.R.size() << " routes, cost "
+                  << TS.SCost << std::endl;
+
+        // what the routes served by time 200 and the first stop of the
+        // longest route, whatever its time
+        TS.lockServed(200);
+        int longest = 0;
+        for (int r=1; r<TS.S.R.size(); r++)
+            if (TS.S.R[r].path.size() > TS.S.R[longest].path.size())
+                longest = r;
+        TS.lockPrefix(longest, std::max(1, TS.S.R[longest].locked));
+
+        std::vector<std::vector<int> > served(TS.S.R.size());
+        int nlocked = 0;
+        for (int r=0; r<TS.S.R.size(); r++) {
+            const Route &R = TS.S.R[r];
+            served[r].assign(R.path.begin(), R.path.begin() + R.locked);
+            nlocked += R.locked;
+        }
+        std::cout << "      locked: " << nlocked << " stops" << std::endl;
+        check(nlocked > 0, "lockServed() and lockPrefix() lock stops");
+
+        bool threw = false;
+        try { TS.lockPrefix(TS.S.R.size(), 1); }
+        catch (const std::exception &e) { threw = true; }
+        check(threw, "lockPrefix() of a route that does not exist throws");
+
+        // an order that was picked up can not be cancelled
+        threw = false;
+        try { TS.cancelOrder(TS.S.R[longest].orders[0]); }
+        catch (const std::exception &e) { threw = true; }
+        check(threw, "cancelling a picked up order throws");
+
+        std::vector<int> cancelled;
+        for (int oid=1; oid<P.O.size() && cancelled.size()<3; oid++) {
+            if (!TS.isMovable(oid)) continue;
+            TS.cancelOrder(oid);
+            cancelled.push_back(oid);
+        }
+        check(cancelled.size() == 3 && routesAreSound(TS.S, cancelled),
+              "cancelled orders are off the routes");
+
+        // the new order is a copy of the first cancelled one
+        Node pickup = P.N[P.O[cancelled[0]].pid];
+        Node delivery = P.N[P.O[cancelled[0]].did];
+        int oid = TS.addOrder(pickup, delivery);
+        check(oid == P.O.size() - 1 && TS.S.mapOtoR[oid] != -1
+              && routesAreSound(TS.S, cancelled),
+              "the added order is on a route");
+
+        TS.resume(100);
+        std::cout << "      resumed: " << TS.S.R.size() << " routes, cost "
+                  << TS.SCost << ", best " << TS.BestCost << std::endl;
+
+        bool kept = true;
+        for (int r=0; r<served.size(); r++) {
+            const Route &R = TS.S.R[r];
+            if (R.path.size() < served[r].size()
+                    || !std::equal(served[r].begin(), served[r].end(), R.path.begin()))
+                kept = false;
+        }
+        check(kept, "locked stops still head their routes after resume()");
+        check(routesAreSound(TS.S, cancelled),
+              "every order is routed once after resume()");
+        check(routesAreSound(TS.Best, cancelled),
+              "Best is sound after resume()");
+    }
+    catch (const std::exception &e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << (failed ? "warm_test: FAILED" : "warm_test: passed") << std::endl;
+    return failed ? 1 : 0;
+}